@@ -0,0 +1,38 @@
+// Render core
+// ===========
+
+/* Short description
+   -----------------
+   Headless, engine independent render core for the episode 3 ray caster. Include this file to get all of it.
+
+   The render core has no dependency on the olc::PixelGameEngine. It renders into an RGBA frame buffer, that can be blitted
+   onto the PGE screen (like the episode 3 code does), or be used without any display at all - for throughput testing,
+   server side thumbnails or regression diffs (see FrameBuffer::SavePPM()).
+
+   Usage:
+       rcc::Renderer renderer;
+       renderer.SetThreads( 0 );   // optional - render the slices on all hardware threads
+       renderer.renderFrame( camera, map, textures, entities.Data(), entities.Size(), rcc::PackRGB( 64, 64, 64 ));
+       const rcc::FrameBuffer &frame = renderer.GetFrame();
+ */
+
+#ifndef RENDER_CORE_H
+#define RENDER_CORE_H
+
+#include "rcDefines.h"
+#include "rcFixed.h"
+#include "rcChecks.h"
+#include "rcFrameBuffer.h"
+#include "rcTexturePack.h"
+#include "rcMap.h"
+#include "rcRayCast.h"
+#include "rcEntities.h"
+#include "rcVisibility.h"
+#include "rcPathfinding.h"
+#include "rcSimulation.h"
+#include "rcTextures.h"
+#include "rcWorkerPool.h"
+#include "rcSimd.h"
+#include "rcRenderer.h"
+
+#endif // RENDER_CORE_H
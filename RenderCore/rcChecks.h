@@ -0,0 +1,122 @@
+// Render core - access checks
+// ===========================
+
+/* Short description
+   -----------------
+   Bounds checking of the texel and map tile reads in the render loops. The checks are a policy that is selected at
+   compile time:
+
+     * checked (RC_CHECKED_ACCESS 1) - every read is checked. A read that would be out of range is skipped (so that
+       pixel or slice isn't drawn), and is counted per kind of access. The renderer collects the counts per frame and
+       reports them once at the end of the frame (see Renderer::GetAccessErrors()), instead of printing a line for
+       every pixel.
+     * unchecked (RC_CHECKED_ACCESS 0) - the checks compile to nothing, the render loops read straight away.
+
+   By default the checks are on in debug builds (NDEBUG not defined) and in builds with the address or thread sanitizer,
+   and off in release builds. Define RC_CHECKED_ACCESS as 0 or 1 to override this.
+ */
+
+#ifndef RC_CHECKS_H
+#define RC_CHECKS_H
+
+#include <atomic>
+#include <cstdint>
+
+#if !defined( RC_CHECKED_ACCESS )
+    #if defined( __has_feature )
+        #if __has_feature( address_sanitizer ) || __has_feature( thread_sanitizer )
+            #define RC_SANITIZED_BUILD
+        #endif
+    #endif
+    #if !defined( NDEBUG ) || defined( __SANITIZE_ADDRESS__ ) || defined( __SANITIZE_THREAD__ ) || defined( RC_SANITIZED_BUILD )
+        #define RC_CHECKED_ACCESS 1
+    #else
+        #define RC_CHECKED_ACCESS 0
+    #endif
+#endif
+
+namespace rcc {
+
+    // the kinds of reads that are checked
+    enum AccessKind {
+        ACCESS_WALL_TEXEL = 0,
+        ACCESS_FLOOR_TEXEL,
+        ACCESS_CEIL_TEXEL,
+        ACCESS_MAP_TILE,
+        ACCESS_KINDS
+    };
+
+    inline const char *AccessKindName( int nKind ) {
+        static const char *sNames[ACCESS_KINDS] = { "wall texel", "floor texel", "ceiling texel", "map tile" };
+        return nKind >= 0 && nKind < ACCESS_KINDS ? sNames[nKind] : "unknown";
+    }
+
+    // the out of range reads of one frame, per kind of access
+    struct AccessErrors {
+        uint32_t nCount[ACCESS_KINDS] = {};       // number of reads that were out of range
+        int      nFirstIndex[ACCESS_KINDS] = {};  // the index of the first one (for the diagnostics)
+
+        uint32_t Total() const {
+            uint32_t nTotal = 0;
+            for (int k = 0; k < ACCESS_KINDS; k++) {
+                nTotal += nCount[k];
+            }
+            return nTotal;
+        }
+    };
+
+    // Collects the out of range reads during a frame - the slices are rendered in parallel, so the counters are atomic.
+    // They are only touched when a check fails
+    class AccessCounters {
+
+    public:
+        void Reset() {
+            for (int k = 0; k < ACCESS_KINDS; k++) {
+                nCount[k].store( 0, std::memory_order_relaxed );
+                nFirstIndex[k].store( 0, std::memory_order_relaxed );
+            }
+        }
+        void Count( AccessKind kind, int ix ) {
+            if (nCount[kind].fetch_add( 1, std::memory_order_relaxed ) == 0) {
+                nFirstIndex[kind].store( ix, std::memory_order_relaxed );
+            }
+        }
+        AccessErrors Get() const {
+            AccessErrors errors;
+            for (int k = 0; k < ACCESS_KINDS; k++) {
+                errors.nCount[k]      = nCount[k].load( std::memory_order_relaxed );
+                errors.nFirstIndex[k] = nFirstIndex[k].load( std::memory_order_relaxed );
+            }
+            return errors;
+        }
+
+    private:
+        std::atomic<uint32_t> nCount[ACCESS_KINDS]      = {};
+        std::atomic<int>      nFirstIndex[ACCESS_KINDS] = {};
+    };
+
+    // The check policy: InRange() returns true if index ix is in [0, nSize) - a failed check is counted
+    template <bool bCheck> struct AccessPolicy;
+
+    template <> struct AccessPolicy<true> {
+        static constexpr bool bChecked = true;
+        static bool InRange( AccessCounters &counters, AccessKind kind, int ix, int nSize ) {
+            if (uint32_t( ix ) < uint32_t( nSize )) {
+                return true;
+            }
+            counters.Count( kind, ix );
+            return false;
+        }
+    };
+
+    template <> struct AccessPolicy<false> {
+        static constexpr bool bChecked = false;
+        static bool InRange( AccessCounters &, AccessKind, int, int ) { return true; }
+    };
+
+    // the policy that the renderer uses
+    typedef AccessPolicy<RC_CHECKED_ACCESS != 0> Access;
+
+} // namespace rcc
+
+#endif // RC_CHECKS_H
@@ -0,0 +1,86 @@
+// Render core - constants
+// =======================
+
+/* Short description
+   -----------------
+   The constants that are shared between the render core and the game code that uses it. They used to live at the top of
+   the episode 3 code file, and are moved here so that the render core can be compiled on its own (without the PGE).
+ */
+
+#ifndef RC_DEFINES_H
+#define RC_DEFINES_H
+
+// ====================   Constants   ==============================
+
+#define PI 3.1415926535f
+#define P2  1.0f * PI / 2.0f
+#define P3  3.0f * PI / 2.0f
+
+#define DR  0.0174533f    // one degree in radians
+
+// you can define multiple types for multiple wall types
+#define EMPTY      '.'
+#define WALL_CBRD  'C'
+#define WALL_BRCK  'B'
+#define WINDOW     'W'
+#define DOOR       'D'
+#define WALL_LGTH  'L'
+#define WALL_END   'E'
+
+#define FLOOR_WOOD '1'
+#define FLOOR_BRCK '2'
+#define FLOOR_1    '3'
+#define FLOOR_2    '4'
+#define FLOOR_3    '5'
+#define FLOOR_4    '6'
+
+#define CEIL_WOOD  '1'
+#define CEIL_BRCK  '2'
+#define CEIL_1     '3'
+#define CEIL_2     '4'
+#define CEIL_3     '5'
+#define CEIL_4     '6'
+
+// sprite (entity) types - see rcEntities.h
+#define SPRITE_KEY    1
+#define SPRITE_LIGHT  2
+#define SPRITE_ENEMY  3
+
+// margin used in bIsEqual() (and checking signedness of sin() and cos() results)
+#define EPSILON  0.00001f
+
+// determines rendering of the 3d view - the slice width is the default, it can be set at runtime (see
+// Renderer::SetResolution()). One ray is cast per slice.
+#define FOV           60.0f
+#define SLICE_WIDTH    8
+#define SLICE_GRAIN    4    // number of slices a render thread claims at a time
+#define ROW_GRAIN      8    // number of floor rows a render thread claims at a time (row based floor casting)
+#define SKIP_MIN_DIST 16    // the ray caster only skips empty space around tiles at least this far from a wall - a
+                            // skip costs about as much as 10 to 20 plain steps
+#define DEPTH_FAR     1e30f // depth buffer value where there's no geometry (the sky, or a ray that left the map)
+
+// potentially visible sets (see rcVisibility.h): number of rays cast from each sample point, and number of cached sets
+#define PVS_RAYS      720
+#define PVS_CACHE_SIZE 64
+#define VIS_MIN_ENTITIES 256   // with fewer entities, projecting all sprites is cheaper than gathering the visible ones
+
+// game logic on its own thread (see rcSimulation.h): steps per second, and the max number of steps to catch up with
+#define SIM_RATE       60.0f
+#define SIM_MAX_CATCHUP    5
+
+// determines rendering of the 2d map and size of the world
+#define TILE_SIZE     64
+
+// all textures (walls, floors, ceilings and sprites) are 32x32 pixels
+#define TEX_SIZE      32
+#define NR_TEXTURES   10    // number of textures in All_Textures[]
+
+// the sky texture is 120 pixels wide - its top 40 rows are stretched over the top half of the screen
+#define SKY_X        120
+#define SKY_Y         40
+
+// default screen dimensions - the projection constants in the renderer are relative to this screen size
+#define SCREEN_X    960
+#define SCREEN_Y    640
+
+#endif // RC_DEFINES_H
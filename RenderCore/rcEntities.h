@@ -0,0 +1,249 @@
+// Render core - entities
+// ======================
+
+/* Short description
+   -----------------
+   The objects in the world (keys, lights, enemies, pickups, ...) are sprites. The entity store holds any number of
+   them in one contiguous array, which is what the renderer takes as input (see Renderer::renderFrame()).
+
+   An entity is referred to by its handle: the index it got when it was added. Entities are never removed, so the
+   handles stay valid - an entity that is picked up or killed is switched off (state 0), and isn't drawn anymore.
+
+   Game logic doesn't need to know the handles: the store keeps a list of the entities per type (SPRITE_KEY,
+   SPRITE_ENEMY etc. from rcDefines.h), so "the key" or "all enemies" can be looked up with FindFirst() and OfType().
+   The type of an entity is fixed once it's added.
+
+   For proximity queries (pickups, contact with enemies, "which objects are in this tile") the store can index the
+   entities in a uniform grid with one cell per map tile (see SetGrid()). The grid keeps a linked list of entities per
+   cell, so adding or moving an entity is O(1), and a query only visits the cells it overlaps. Entities must be moved
+   with Move() to keep the grid up to date. Entities that are switched off stay in the grid - the queries return them,
+   it's up to the caller to check the state.
+ */
+
+#ifndef RC_ENTITIES_H
+#define RC_ENTITIES_H
+
+#include <cmath>
+#include <vector>
+#include <algorithm>
+
+#include "rcDefines.h"
+
+namespace rcc {
+
+    // ====================   SpatialGrid   ==============================
+
+    // Uniform grid over the map, with a cell per tile. Each entity is in exactly one cell (positions outside of the map
+    // are clamped to the border cells), and the entities of a cell form a doubly linked list through their nodes.
+    class SpatialGrid {
+
+    public:
+        // sets up a grid of nW x nH cells of nCellSize x nCellSize world units - the grid is empty afterwards
+        void Resize( int nW, int nH, int nCellSize ) {
+            nCellsX = std::max( 0, nW );
+            nCellsY = std::max( 0, nH );
+            fCellSize = float( std::max( 1, nCellSize ));
+            vHead.assign( size_t( nCellsX ) * nCellsY, -1 );
+            vNodes.clear();
+        }
+        // removes all entities, the size stays the same
+        void Clear() {
+            std::fill( vHead.begin(), vHead.end(), -1 );
+            vNodes.clear();
+        }
+        bool IsSetUp() const { return nCellsX > 0 && nCellsY > 0; }
+
+        void Insert( int nHandle, float x, float y ) {
+            if (nHandle >= int( vNodes.size())) {
+                vNodes.resize( nHandle + 1 );
+            }
+            Node &node = vNodes[nHandle];
+            if (node.nCell >= 0) {
+                unlink( nHandle );
+            }
+            node.x = x;
+            node.y = y;
+            link( nHandle, cellIndex( x, y ));
+        }
+        void Remove( int nHandle ) {
+            if (nHandle >= 0 && nHandle < int( vNodes.size()) && vNodes[nHandle].nCell >= 0) {
+                unlink( nHandle );
+            }
+        }
+        // updates the position of an entity - it's only moved to another list if it changes cell
+        void Move( int nHandle, float x, float y ) {
+            if (nHandle < 0 || nHandle >= int( vNodes.size()) || vNodes[nHandle].nCell < 0) {
+                Insert( nHandle, x, y );
+                return;
+            }
+            Node &node = vNodes[nHandle];
+            node.x = x;
+            node.y = y;
+            int nCell = cellIndex( x, y );
+            if (nCell != node.nCell) {
+                unlink( nHandle );
+                link( nHandle, nCell );
+            }
+        }
+
+        // the entities in tile (cx, cy): iterate with for (int h = FirstInTile( cx, cy ); h >= 0; h = NextInTile( h ))
+        int FirstInTile( int cx, int cy ) const {
+            return cx >= 0 && cy >= 0 && cx < nCellsX && cy < nCellsY ? vHead[size_t( cy ) * nCellsX + cx] : -1;
+        }
+        int NextInTile( int nHandle ) const { return vNodes[nHandle].nNext; }
+
+        template <class F> void ForEachInTile( int cx, int cy, F fn ) const {
+            for (int h = FirstInTile( cx, cy ); h >= 0; h = NextInTile( h )) {
+                fn( h );
+            }
+        }
+        // calls fn( handle ) for the entities with x0 < x < x1 and y0 < y < y1 - fn must not move entities
+        template <class F> void ForEachInRect( float x0, float y0, float x1, float y1, F fn ) const {
+            if (!IsSetUp()) {
+                return;
+            }
+            const int cx0 = clampX( x0 ), cx1 = clampX( x1 ), cy0 = clampY( y0 ), cy1 = clampY( y1 );
+            for (int cy = cy0; cy <= cy1; cy++) {
+                for (int cx = cx0; cx <= cx1; cx++) {
+                    for (int h = vHead[size_t( cy ) * nCellsX + cx]; h >= 0; h = vNodes[h].nNext) {
+                        const Node &node = vNodes[h];
+                        if (node.x > x0 && node.x < x1 && node.y > y0 && node.y < y1) {
+                            fn( h );
+                        }
+                    }
+                }
+            }
+        }
+        // calls fn( handle ) for the entities within distance fRadius of (x, y) - fn must not move entities
+        template <class F> void ForEachInRadius( float x, float y, float fRadius, F fn ) const {
+            const float fRadius2 = fRadius * fRadius;
+            ForEachInRect( x - fRadius - 1.0f, y - fRadius - 1.0f, x + fRadius + 1.0f, y + fRadius + 1.0f, [&]( int h ) {
+                float dx = vNodes[h].x - x, dy = vNodes[h].y - y;
+                if (dx * dx + dy * dy <= fRadius2) {
+                    fn( h );
+                }
+            } );
+        }
+
+    private:
+        struct Node {
+            float x = 0.0f, y = 0.0f;
+            int nCell = -1;              // -1 if the entity isn't in the grid
+            int nPrev = -1, nNext = -1;  // neighbours in the list of the cell
+        };
+        int nCellsX = 0, nCellsY = 0;
+        float fCellSize = float( TILE_SIZE );
+        std::vector<int>  vHead;    // first entity per cell
+        std::vector<Node> vNodes;   // per entity handle
+
+        int clampX( float x ) const { return std::min( std::max( int( std::floor( x / fCellSize )), 0 ), nCellsX - 1 ); }
+        int clampY( float y ) const { return std::min( std::max( int( std::floor( y / fCellSize )), 0 ), nCellsY - 1 ); }
+        int cellIndex( float x, float y ) const { return IsSetUp() ? clampY( y ) * nCellsX + clampX( x ) : -1; }
+
+        void link( int nHandle, int nCell ) {
+            Node &node = vNodes[nHandle];
+            node.nCell = nCell;
+            node.nPrev = -1;
+            node.nNext = -1;
+            if (nCell < 0) {
+                return;
+            }
+            node.nNext = vHead[nCell];
+            if (node.nNext >= 0) {
+                vNodes[node.nNext].nPrev = nHandle;
+            }
+            vHead[nCell] = nHandle;
+        }
+        void unlink( int nHandle ) {
+            Node &node = vNodes[nHandle];
+            if (node.nPrev >= 0) {
+                vNodes[node.nPrev].nNext = node.nNext;
+            } else {
+                vHead[node.nCell] = node.nNext;
+            }
+            if (node.nNext >= 0) {
+                vNodes[node.nNext].nPrev = node.nPrev;
+            }
+            node.nCell = node.nPrev = node.nNext = -1;
+        }
+    };
+
+    // ====================   EntityStore   ==============================
+
+    struct Sprite {
+        int type;     // SPRITE_KEY, SPRITE_LIGHT, SPRITE_ENEMY, ...
+        int state;    // 1 = on (drawn), 0 = off
+        int nMap;     // texture to show - index in the texture array ig
+        float x, y, z;  // position [ could this be an flc::vi3d type ? ]
+    };
+
+    class EntityStore {
+
+    public:
+        void Clear() {
+            vEntities.clear();
+            vByType.clear();
+            grid.Clear();
+        }
+        void Reserve( int nEntities ) { vEntities.reserve( nEntities ); }
+
+        // adds an entity and returns its handle
+        int Add( const Sprite &s ) {
+            int nHandle = int( vEntities.size());
+            vEntities.push_back( s );
+            if (s.type >= int( vByType.size())) {
+                vByType.resize( s.type + 1 );
+            }
+            vByType[s.type].push_back( nHandle );
+            if (grid.IsSetUp()) {
+                grid.Insert( nHandle, s.x, s.y );
+            }
+            return nHandle;
+        }
+
+        // indexes the entities in a grid of nW x nH tiles of nTileSize world units - normally the size of the map
+        void SetGrid( int nW, int nH, int nTileSize = TILE_SIZE ) {
+            grid.Resize( nW, nH, nTileSize );
+            for (int h = 0; h < Size(); h++) {
+                grid.Insert( h, vEntities[h].x, vEntities[h].y );
+            }
+        }
+        const SpatialGrid &Grid() const { return grid; }
+
+        // moves an entity, and keeps the grid up to date
+        void Move( int nHandle, float x, float y ) {
+            vEntities[nHandle].x = x;
+            vEntities[nHandle].y = y;
+            if (grid.IsSetUp()) {
+                grid.Move( nHandle, x, y );
+            }
+        }
+
+        int Size() const { return int( vEntities.size()); }
+
+        Sprite       &operator [] ( int nHandle )       { return vEntities[nHandle]; }
+        const Sprite &operator [] ( int nHandle ) const { return vEntities[nHandle]; }
+
+        // all entities, in order of their handles - this is the sprite list for the renderer
+        const Sprite *Data() const { return vEntities.data(); }
+
+        // the handles of the entities of type nType, in the order they were added
+        const std::vector<int> &OfType( int nType ) const {
+            return nType >= 0 && nType < int( vByType.size()) ? vByType[nType] : vNone;
+        }
+        // the handle of the first entity of type nType, or -1 if there is none
+        int FindFirst( int nType ) const {
+            const std::vector<int> &vHandles = OfType( nType );
+            return vHandles.empty() ? -1 : vHandles[0];
+        }
+
+    private:
+        std::vector<Sprite> vEntities;
+        std::vector<std::vector<int>> vByType;   // handles per entity type
+        std::vector<int> vNone;
+        SpatialGrid grid;
+    };
+
+} // namespace rcc
+
+#endif // RC_ENTITIES_H
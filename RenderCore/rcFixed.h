@@ -0,0 +1,56 @@
+// Render core - fixed point
+// =========================
+
+/* Short description
+   -----------------
+   The ray stepping, the wall texture stepping and the (row based) floor coordinate stepping can be done in fixed point
+   instead of in float. Define RC_FIXED_POINT (before including the render core, or on the compiler command line) to
+   select the fixed point pipeline at compile time.
+
+   In fixed point mode the texture loops don't need float to int conversions anymore - a texel coordinate is just a
+   shift - and the stepping is exact integer arithmetic, so the output doesn't depend on the compiler or its floating
+   point settings. The frames differ slightly from the float version (a texel more or less at some texture edges), use
+   the --compare option of the benchmark tool to check how much.
+
+   The stepped values have type Scalar - float by default, 48.16 fixed point (in an int64_t) with RC_FIXED_POINT. The
+   wall texture stepping uses 16.16 fixed point in an int32_t (see ShadeStrip() in rcSimd.h).
+ */
+
+#ifndef RC_FIXED_H
+#define RC_FIXED_H
+
+#include <cstdint>
+#include <cmath>
+
+#define FIX_SHIFT  16
+#define FIX_ONE    (1 << FIX_SHIFT)
+
+namespace rcc {
+
+    typedef int32_t fix16;   // 16.16 fixed point
+
+    // converts float f to fixed point, rounded to the nearest value
+    inline fix16 FloatToFix( float f ) { return fix16( std::floor( double( f ) * FIX_ONE + 0.5 )); }
+    inline float FixToFloat( fix16 f ) { return float( f ) / FIX_ONE; }
+
+#if defined( RC_FIXED_POINT )
+    typedef int64_t Scalar;
+    #define SCALAR_MAX  (int64_t( 1 ) << 50)     // "never" - big, but can still be multiplied by a few thousand
+
+    inline Scalar ToScalar( float f )          { return Scalar( std::floor( double( f ) * FIX_ONE + 0.5 )); }
+    inline float  ScalarToFloat( Scalar s )    { return float( double( s ) / FIX_ONE ); }
+    // the integer part (rounded down)
+    inline int    ScalarToInt( Scalar s )      { return int( s >> FIX_SHIFT ); }
+#else
+    typedef float Scalar;
+    #define SCALAR_MAX  1.0e30f
+
+    inline Scalar ToScalar( float f )          { return f; }
+    inline float  ScalarToFloat( Scalar s )    { return s; }
+    // the integer part (rounded towards 0, like int())
+    inline int    ScalarToInt( Scalar s )      { return int( s ); }
+#endif
+
+} // namespace rcc
+
+#endif // RC_FIXED_H
@@ -0,0 +1,179 @@
+// Render core - frame buffer
+// ==========================
+
+/* Short description
+   -----------------
+   A plain RGBA frame buffer in main memory. The render core draws into it, and the game (or a headless tool) decides
+   what to do with the result: blit it to the PGE screen, save it to a file, compare it with a reference image etc.
+
+   The pixels are packed in 32 bits in the same byte order as olc::Pixel (r in the lowest byte, a in the highest),
+   so that blitting to a PGE draw target is a straight memory copy.
+ */
+
+#ifndef RC_FRAMEBUFFER_H
+#define RC_FRAMEBUFFER_H
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <cstdlib>
+
+#include "rcDefines.h"
+
+namespace rcc {
+
+    // packs r, g, b and a into a 32 bit pixel value, using the olc::Pixel byte order
+    inline uint32_t PackRGB( int r, int g, int b, int a = 255 ) {
+        return uint32_t( r & 0xFF ) | (uint32_t( g & 0xFF ) << 8) | (uint32_t( b & 0xFF ) << 16) | (uint32_t( a & 0xFF ) << 24);
+    }
+    inline int GetR( uint32_t p ) { return  p        & 0xFF; }
+    inline int GetG( uint32_t p ) { return (p >>  8) & 0xFF; }
+    inline int GetB( uint32_t p ) { return (p >> 16) & 0xFF; }
+
+    class FrameBuffer {
+
+    public:
+        FrameBuffer( int nW, int nH ) { Resize( nW, nH ); }
+
+        void Resize( int nW, int nH ) {
+            nWidth  = nW;
+            nHeight = nH;
+            vPixels.assign( size_t( nW ) * size_t( nH ), PackRGB( 0, 0, 0 ));
+        }
+
+        int Width()  const { return nWidth;  }
+        int Height() const { return nHeight; }
+
+        uint32_t       *GetData()       { return vPixels.data(); }
+        const uint32_t *GetData() const { return vPixels.data(); }
+
+        uint32_t GetPixel( int x, int y ) const {
+            return (x < 0 || y < 0 || x >= nWidth || y >= nHeight) ? 0 : vPixels[y * nWidth + x];
+        }
+
+        void Clear( uint32_t p ) {
+            std::fill( vPixels.begin(), vPixels.end(), p );
+        }
+
+        // sets one pixel - pixels outside the frame buffer are ignored
+        void Draw( int x, int y, uint32_t p ) {
+            if (x >= 0 && y >= 0 && x < nWidth && y < nHeight) {
+                vPixels[y * nWidth + x] = p;
+            }
+        }
+
+        // fills a w x h rectangle with top left corner at (x, y) - the rectangle is clipped against the frame buffer
+        void FillRect( int x, int y, int w, int h, uint32_t p ) {
+            int x1 = std::min( x + w, nWidth  ), x0 = std::max( x, 0 );
+            int y1 = std::min( y + h, nHeight ), y0 = std::max( y, 0 );
+            for (int j = y0; j < y1; j++) {
+                for (int i = x0; i < x1; i++) {
+                    vPixels[j * nWidth + i] = p;
+                }
+            }
+        }
+
+        // -----   SPAN WRITER   -----
+
+        // Direct, unchecked access for the inner loops of the renderer. Draw() and FillRect() pay clipping and bounds
+        // checking per call, which dominates the frame time when it's done for every texel. The span writer functions
+        // leave it to the caller to stay within the frame buffer, so that the draw cost is proportional to the pixels.
+
+        uint32_t       *Row( int y )       { return vPixels.data() + size_t( y ) * nWidth; }
+        const uint32_t *Row( int y ) const { return vPixels.data() + size_t( y ) * nWidth; }
+        int Stride() const { return nWidth; }
+
+        // writes w pixels of value p, starting at pDst - the SLICE_WIDTH case has a fixed size (unrolled) fill
+        static void FillSpan( uint32_t *pDst, int w, uint32_t p ) {
+            if (w == SLICE_WIDTH) {
+                FillSpanN<SLICE_WIDTH>( pDst, p );
+            } else {
+                for (int i = 0; i < w; i++) { pDst[i] = p; }
+            }
+        }
+        template <int W>
+        static void FillSpanN( uint32_t *pDst, uint32_t p ) {
+            for (int i = 0; i < W; i++) { pDst[i] = p; }
+        }
+
+        // fills a vertical strip of w pixels wide and h pixels high, starting at pDst
+        void FillStrip( uint32_t *pDst, int w, int h, uint32_t p ) {
+            for (int j = 0; j < h; j++, pDst += nWidth) {
+                FillSpan( pDst, w, p );
+            }
+        }
+
+        // copies all pixels to pDst, which must be (at least) Width() x Height() pixels of the same format
+        void CopyTo( void *pDst ) const {
+            memcpy( pDst, vPixels.data(), vPixels.size() * sizeof( uint32_t ));
+        }
+
+        // writes the frame buffer as a binary (P6) portable pixmap - useful for thumbnails and regression diffs
+        bool SavePPM( const std::string &sFileName ) const {
+            FILE *pFile = fopen( sFileName.c_str(), "wb" );
+            if (pFile == nullptr) {
+                return false;
+            }
+            fprintf( pFile, "P6\n%d %d\n255\n", nWidth, nHeight );
+            std::vector<uint8_t> vRow( size_t( nWidth ) * 3 );
+            for (int y = 0; y < nHeight; y++) {
+                for (int x = 0; x < nWidth; x++) {
+                    uint32_t p = vPixels[y * nWidth + x];
+                    vRow[x * 3 + 0] = GetR( p );
+                    vRow[x * 3 + 1] = GetG( p );
+                    vRow[x * 3 + 2] = GetB( p );
+                }
+                fwrite( vRow.data(), 1, vRow.size(), pFile );
+            }
+            fclose( pFile );
+            return true;
+        }
+
+        // reads a binary (P6) portable pixmap with 8 bit channels, like the ones SavePPM() writes, and resizes the
+        // frame buffer to it - returns false if the file can't be read
+        bool LoadPPM( const std::string &sFileName ) {
+            FILE *pFile = fopen( sFileName.c_str(), "rb" );
+            if (pFile == nullptr) {
+                return false;
+            }
+            int nW = 0, nH = 0, nMax = 0;
+            bool bOk = fscanf( pFile, "P6 %d %d %d", &nW, &nH, &nMax ) == 3 && nW > 0 && nH > 0 && nMax == 255 && fgetc( pFile ) != EOF;
+            std::vector<uint8_t> vData( bOk ? size_t( nW ) * nH * 3 : 0 );
+            bOk = bOk && fread( vData.data(), 1, vData.size(), pFile ) == vData.size();
+            fclose( pFile );
+            if (bOk) {
+                Resize( nW, nH );
+                for (size_t i = 0; i < vPixels.size(); i++) {
+                    vPixels[i] = PackRGB( vData[i * 3 + 0], vData[i * 3 + 1], vData[i * 3 + 2] );
+                }
+            }
+            return bOk;
+        }
+
+        // number of pixels that differ from the same pixel in other by more than nTolerance in any colour channel -
+        // (the alpha channel is ignored). If the sizes differ, all pixels differ
+        size_t CountDiffs( const FrameBuffer &other, int nTolerance = 0 ) const {
+            if (other.nWidth != nWidth || other.nHeight != nHeight) {
+                return vPixels.size();
+            }
+            size_t nDiffs = 0;
+            for (size_t i = 0; i < vPixels.size(); i++) {
+                uint32_t a = vPixels[i], b = other.vPixels[i];
+                int nDiff = std::max( std::max( std::abs( GetR( a ) - GetR( b )), std::abs( GetG( a ) - GetG( b ))), std::abs( GetB( a ) - GetB( b )));
+                if (nDiff > nTolerance) { nDiffs++; }
+            }
+            return nDiffs;
+        }
+
+    private:
+        int nWidth  = 0;
+        int nHeight = 0;
+        std::vector<uint32_t> vPixels;
+    };
+
+} // namespace rcc
+
+#endif // RC_FRAMEBUFFER_H
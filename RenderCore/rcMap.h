@@ -0,0 +1,360 @@
+// Render core - map
+// =================
+
+/* Short description
+   -----------------
+   Tile maps of any size. Each tile has a wall type, a floor type and a ceiling type, which are the tile characters
+   from rcDefines.h (EMPTY, WALL_BRCK, FLOOR_WOOD etc.). The three layers are stored as separate byte arrays of
+   mapX x mapY tiles, row by row, so tile (x, y) of a layer is at index y * mapX + x.
+
+   Maps can be set up from strings (like the episode 3 map in init()), or loaded from a text file:
+
+       # comment lines (and empty lines) are ignored
+       RCMAP <width> <height>
+       <height lines of width characters - the walls>
+       <height lines of width characters - the floor>
+       <height lines of width characters - the ceiling>
+
+   The renderer doesn't assume that the map is closed - rays that leave the map without hitting a wall just stop at
+   the map border, and the floor and ceiling are only drawn within the map.
+
+   For big, open maps the map keeps a distance field of the walls: for each tile the distance to the nearest wall. The
+   ray caster uses it to skip over the empty square around a tile instead of checking every grid line. The field is
+   rebuilt by the Load...() and Resize() functions and by SetWall() - if you change mapW directly, call
+   UpdateOccupancy() afterwards. Every change of the walls gives the map a new version, so that data derived from the
+   walls (like the potentially visible sets, see rcVisibility.h) knows when to rebuild. The versions are unique over
+   all maps, so replacing a map by another one is noticed as well - only a copy of a map has the same version.
+
+   The renderer doesn't decode the tile characters: the map resolves them into texture offsets per tile (the offset
+   of the texture in the texture atlas, in texels), using a table with an entry per tile character for each layer
+   (see TileTextureTable). The renderer's inner loops just read the offset of the tile. Load...(), Resize() and
+   SetWall() keep the offsets up to date - if you change the layers or the table directly, call UpdateTextures().
+
+   TileSet is a set of tiles of a map (a bit per tile), used for the tiles that are visible in a frame.
+ */
+
+#ifndef RC_MAP_H
+#define RC_MAP_H
+
+#include <cstdint>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+
+#include "rcDefines.h"
+
+#define RCMAP_MAGIC "RCMAP"
+
+namespace rcc {
+
+    // Chebyshev distance (in tiles) from every tile to the nearest wall, capped at 255. If tile (x, y) has distance d,
+    // there are no walls in the square of (2d - 1) x (2d - 1) tiles around it.
+    class WallDistanceField {
+
+    public:
+        // computes the distances for a wall layer of nW x nH tiles - two passes over the map, the first one propagating
+        // the distances from the top left, the second one from the bottom right
+        void Build( int nW, int nH, const uint8_t *pWalls ) {
+            nMapX = nW;
+            nMapY = nH;
+            vDist.resize( size_t( nW ) * nH );
+            for (int y = 0; y < nH; y++) {
+                for (int x = 0; x < nW; x++) {
+                    int nDist = 255;
+                    if (pWalls[Index( x, y )] != EMPTY) {
+                        nDist = 0;
+                    } else {
+                        if (x > 0)                    { nDist = std::min( nDist, vDist[Index( x - 1, y     )] + 1 ); }
+                        if (y > 0)                    { nDist = std::min( nDist, vDist[Index( x    , y - 1 )] + 1 ); }
+                        if (x > 0 && y > 0)           { nDist = std::min( nDist, vDist[Index( x - 1, y - 1 )] + 1 ); }
+                        if (x < nW - 1 && y > 0)      { nDist = std::min( nDist, vDist[Index( x + 1, y - 1 )] + 1 ); }
+                    }
+                    vDist[Index( x, y )] = uint8_t( nDist );
+                }
+            }
+            for (int y = nH - 1; y >= 0; y--) {
+                for (int x = nW - 1; x >= 0; x--) {
+                    int nDist = vDist[Index( x, y )];
+                    if (x < nW - 1)                   { nDist = std::min( nDist, vDist[Index( x + 1, y     )] + 1 ); }
+                    if (y < nH - 1)                   { nDist = std::min( nDist, vDist[Index( x    , y + 1 )] + 1 ); }
+                    if (x < nW - 1 && y < nH - 1)     { nDist = std::min( nDist, vDist[Index( x + 1, y + 1 )] + 1 ); }
+                    if (x > 0 && y < nH - 1)          { nDist = std::min( nDist, vDist[Index( x - 1, y + 1 )] + 1 ); }
+                    vDist[Index( x, y )] = uint8_t( nDist );
+                }
+            }
+        }
+
+        // true if the field was built for a map of nW x nH tiles
+        bool Matches( int nW, int nH ) const { return nMapX == nW && nMapY == nH; }
+
+        int Distance( int x, int y ) const { return vDist[Index( x, y )]; }
+        // the distances, row by row like the map layers
+        const uint8_t *GetData() const { return vDist.data(); }
+
+    private:
+        int nMapX = 0, nMapY = 0;
+        std::vector<uint8_t> vDist;
+
+        size_t Index( int x, int y ) const { return size_t( y ) * nMapX + x; }
+    };
+
+    // The texture index (in the texture atlas) for each tile character, for each of the three layers - -1 means no
+    // texture. The defaults are the tile types from rcDefines.h, other tile types can be added by setting entries.
+    //
+    //     map <--> character <--> constant / type <--> index <--> texture
+    struct TileTextureTable {
+        int nWall[256], nFloor[256], nCeil[256];
+
+        TileTextureTable() {
+            std::fill( nWall , nWall  + 256, -1 );
+            std::fill( nFloor, nFloor + 256, -1 );
+            std::fill( nCeil , nCeil  + 256, -1 );
+            nWall[ uint8_t( WALL_CBRD  )] = 0;
+            nWall[ uint8_t( WALL_BRCK  )] = 3;
+            nWall[ uint8_t( WINDOW     )] = 2;
+            nWall[ uint8_t( DOOR       )] = 4;
+            nWall[ uint8_t( WALL_LGTH  )] = 8;
+            nWall[ uint8_t( WALL_END   )] = 1;
+            nFloor[uint8_t( FLOOR_WOOD )] = 0;
+            nFloor[uint8_t( FLOOR_BRCK )] = 3;
+            nFloor[uint8_t( FLOOR_1    )] = 6;
+            nFloor[uint8_t( FLOOR_2    )] = 7;
+            nFloor[uint8_t( FLOOR_3    )] = 8;
+            nFloor[uint8_t( FLOOR_4    )] = 9;
+            nCeil[ uint8_t( CEIL_WOOD  )] = 0;
+            nCeil[ uint8_t( CEIL_BRCK  )] = 3;
+            nCeil[ uint8_t( CEIL_1     )] = 6;
+            nCeil[ uint8_t( CEIL_2     )] = 7;
+            nCeil[ uint8_t( CEIL_3     )] = 8;
+            nCeil[ uint8_t( CEIL_4     )] = 9;
+        }
+
+        // the texture offsets (in texels) that the map stores per tile, -1 = nothing to draw. Walls of an unknown type
+        // get texture 0, so that every wall the rays hit can be drawn. The ceiling is only drawn for textures > 0, so
+        // that the sky shows where there's no ceiling (this has always excluded texture 0)
+        int32_t WallOffset(  uint8_t c ) const { return c == uint8_t( EMPTY ) ? -1 : std::max( nWall[c], 0 ) * TEX_SIZE * TEX_SIZE; }
+        int32_t FloorOffset( uint8_t c ) const { return nFloor[c] < 0 ? -1 : nFloor[c] * TEX_SIZE * TEX_SIZE; }
+        int32_t CeilOffset(  uint8_t c ) const { return nCeil[c]  > 0 ? nCeil[c] * TEX_SIZE * TEX_SIZE : -1; }
+    };
+
+    // A set of tiles of an nW x nH map, stored as a bitset. Set() can be called from several threads at the same time
+    // (the render threads mark the tiles their rays pass) - the other functions must not run concurrently with it.
+    class TileSet {
+
+    public:
+        // sets the size, the set is empty afterwards
+        void Resize( int nW, int nH ) {
+            nTilesX = nW;
+            nTilesY = nH;
+            nWords  = (size_t( nW ) * nH + 63) / 64;
+            pWords.reset( new std::atomic<uint64_t>[nWords] );
+            Clear();
+        }
+        bool Matches( int nW, int nH ) const { return nTilesX == nW && nTilesY == nH && pWords != nullptr; }
+
+        void Clear() {
+            for (size_t i = 0; i < nWords; i++) {
+                pWords[i].store( 0, std::memory_order_relaxed );
+            }
+        }
+        // adds tile (x, y) - it must be on the map. The word is only written if the bit isn't set yet, since
+        // neighbouring rays mostly pass the same tiles
+        void Set( int x, int y ) {
+            size_t i = size_t( y ) * nTilesX + x;
+            uint64_t nBit = uint64_t( 1 ) << (i & 63);
+            std::atomic<uint64_t> &word = pWords[i >> 6];
+            if ((word.load( std::memory_order_relaxed ) & nBit) == 0) {
+                word.fetch_or( nBit, std::memory_order_relaxed );
+            }
+        }
+        // false for tiles that aren't on the map
+        bool Test( int x, int y ) const {
+            if (x < 0 || y < 0 || x >= nTilesX || y >= nTilesY) {
+                return false;
+            }
+            size_t i = size_t( y ) * nTilesX + x;
+            return (pWords[i >> 6].load( std::memory_order_relaxed ) >> (i & 63)) & 1;
+        }
+        // true if tile (x, y) or one of its 8 neighbours is in the set
+        bool TestNear( int x, int y ) const {
+            for (int dy = -1; dy <= 1; dy++) {
+                for (int dx = -1; dx <= 1; dx++) {
+                    if (Test( x + dx, y + dy )) { return true; }
+                }
+            }
+            return false;
+        }
+        // adds all tiles of another set of the same size
+        void Add( const TileSet &other ) {
+            for (size_t i = 0; i < nWords && i < other.nWords; i++) {
+                pWords[i].fetch_or( other.pWords[i].load( std::memory_order_relaxed ), std::memory_order_relaxed );
+            }
+        }
+        // calls fn( x, y ) for all tiles in the set, row by row
+        template <class F> void ForEach( F fn ) const {
+            for (size_t i = 0; i < nWords; i++) {
+                uint64_t nWord = pWords[i].load( std::memory_order_relaxed );
+                for (int nBit = 0; nWord != 0; nBit++, nWord >>= 1) {
+                    if (nWord & 1) {
+                        int nTile = int( i * 64 ) + nBit;
+                        fn( nTile % nTilesX, nTile / nTilesX );
+                    }
+                }
+            }
+        }
+        int Count() const {
+            int nCount = 0;
+            ForEach( [&]( int, int ) { nCount++; } );
+            return nCount;
+        }
+
+    private:
+        int nTilesX = 0, nTilesY = 0;
+        size_t nWords = 0;
+        std::unique_ptr<std::atomic<uint64_t>[]> pWords;
+    };
+
+    struct Map {
+        int mapX = 0, mapY = 0, mapS = TILE_SIZE;   // grid is mapX x mapY tiles, each tile is mapS x mapS pixels
+        std::vector<uint8_t> mapW;                   // there's a layer for the walls, the floor and the ceiling
+        std::vector<uint8_t> mapF;
+        std::vector<uint8_t> mapC;
+        WallDistanceField occupancy;                 // where the walls are - see the description above
+        int nVersion = NextVersion();                // changes whenever the walls change - see the description above
+        TileTextureTable tileTextures;               // texture per tile character
+        std::vector<int32_t> texW, texF, texC;       // texture offset per tile for each layer (see the description above)
+
+        // sets the size to nW x nH tiles, without walls, with wooden floor and without ceiling
+        void Resize( int nW, int nH ) {
+            mapX = nW;
+            mapY = nH;
+            mapW.assign( size_t( nW ) * nH, EMPTY      );
+            mapF.assign( size_t( nW ) * nH, FLOOR_WOOD );
+            mapC.assign( size_t( nW ) * nH, EMPTY      );
+            UpdateOccupancy();
+            UpdateTextures();
+        }
+
+        // rebuilds the wall distance field - needed after changing mapW directly
+        void UpdateOccupancy() {
+            occupancy.Build( mapX, mapY, mapW.data());
+            nVersion = NextVersion();
+        }
+
+        // a map version that no map has had before
+        static int NextVersion() {
+            static std::atomic<int> nLastVersion( 0 );
+            return nLastVersion.fetch_add( 1, std::memory_order_relaxed ) + 1;
+        }
+
+        // resolves the tile characters of all layers into texture offsets - needed after changing the layers or the
+        // table directly
+        void UpdateTextures() {
+            const size_t nTiles = size_t( mapX ) * mapY;
+            texW.resize( nTiles );
+            texF.resize( nTiles );
+            texC.resize( nTiles );
+            for (size_t i = 0; i < nTiles; i++) {
+                texW[i] = tileTextures.WallOffset(  mapW[i] );
+                texF[i] = tileTextures.FloorOffset( mapF[i] );
+                texC[i] = tileTextures.CeilOffset(  mapC[i] );
+            }
+        }
+
+        // changes the wall type of tile (x, y), and keeps the distance field and the texture offsets up to date
+        void SetWall( int x, int y, char c ) {
+            mapW[Index( x, y )] = uint8_t( c );
+            texW[Index( x, y )] = tileTextures.WallOffset( uint8_t( c ));
+            UpdateOccupancy();
+        }
+
+        bool InBounds( int x, int y ) const { return x >= 0 && y >= 0 && x < mapX && y < mapY; }
+        int  Index(    int x, int y ) const { return y * mapX + x; }
+
+        char Wall(  int x, int y ) const { return char( mapW[Index( x, y )] ); }
+        char Floor( int x, int y ) const { return char( mapF[Index( x, y )] ); }
+        char Ceil(  int x, int y ) const { return char( mapC[Index( x, y )] ); }
+
+        // sets up an nW x nH map from three strings of nW x nH characters - returns false if a string has the wrong size
+        bool LoadFromStrings( int nW, int nH, const std::string &sWalls, const std::string &sFloor, const std::string &sCeil ) {
+            size_t nTiles = size_t( nW ) * nH;
+            if (nW <= 0 || nH <= 0 || sWalls.size() != nTiles || sFloor.size() != nTiles || sCeil.size() != nTiles) {
+                std::cout << "ERROR: Map::LoadFromStrings() --> map strings must be " << nW << " x " << nH << " characters" << std::endl;
+                return false;
+            }
+            mapX = nW;
+            mapY = nH;
+            mapW.assign( sWalls.begin(), sWalls.end());
+            mapF.assign( sFloor.begin(), sFloor.end());
+            mapC.assign( sCeil.begin() , sCeil.end() );
+            UpdateOccupancy();
+            UpdateTextures();
+            return true;
+        }
+
+        // loads a map file (see the description above) - returns false if the file can't be read or is malformed
+        bool LoadFromFile( const std::string &sFileName ) {
+            std::ifstream file( sFileName );
+            if (!file.is_open()) {
+                std::cout << "ERROR: Map::LoadFromFile() --> can't open file: " << sFileName << std::endl;
+                return false;
+            }
+            // reads the next line that isn't empty or a comment
+            std::string sLine;
+            auto next_line = [&]() {
+                while (std::getline( file, sLine )) {
+                    if (!sLine.empty() && sLine.back() == '\r') { sLine.pop_back(); }
+                    if (!sLine.empty() && sLine[0] != '#') { return true; }
+                }
+                return false;
+            };
+
+            std::string sMagic;
+            int nW = 0, nH = 0;
+            if (next_line()) {
+                std::istringstream ss( sLine );
+                ss >> sMagic >> nW >> nH;
+            }
+            if (sMagic != RCMAP_MAGIC || nW <= 0 || nH <= 0) {
+                std::cout << "ERROR: Map::LoadFromFile() --> not a (valid) map file: " << sFileName << std::endl;
+                return false;
+            }
+            std::string sLayers[3];
+            for (auto &sLayer : sLayers) {
+                sLayer.reserve( size_t( nW ) * nH );
+                for (int y = 0; y < nH; y++) {
+                    if (!next_line() || int( sLine.size()) != nW) {
+                        std::cout << "ERROR: Map::LoadFromFile() --> every map line must have " << nW << " characters: " << sFileName << std::endl;
+                        return false;
+                    }
+                    sLayer += sLine;
+                }
+            }
+            return LoadFromStrings( nW, nH, sLayers[0], sLayers[1], sLayers[2] );
+        }
+
+        // writes the map in the format that LoadFromFile() reads - returns false if the file can't be written
+        bool SaveToFile( const std::string &sFileName ) const {
+            std::ofstream file( sFileName );
+            if (!file.is_open()) {
+                return false;
+            }
+            file << RCMAP_MAGIC << " " << mapX << " " << mapY << "\n";
+            for (const std::vector<uint8_t> *pLayer : { &mapW, &mapF, &mapC }) {
+                for (int y = 0; y < mapY; y++) {
+                    file.write( (const char *)pLayer->data() + size_t( y ) * mapX, mapX );
+                    file << "\n";
+                }
+            }
+            return bool( file );
+        }
+    };
+
+} // namespace rcc
+
+#endif // RC_MAP_H
@@ -0,0 +1,113 @@
+// Render core - path finding
+// ==========================
+
+/* Short description
+   -----------------
+   A flow field over the wall map, for any number of agents (enemies) that all want to go to the same place (the
+   player).
+
+   The field is a breadth first search from the target tile over the empty tiles (4-connected - horizontal and
+   vertical steps only). For every tile it stores the number of steps to the target, and the neighbour to step to
+   next. So one search serves all agents: an agent just looks up the next tile for the tile it is in, which is O(1).
+
+   The search is only redone when the target moves to another tile, or when the walls change (a door is opened - see
+   Map::nVersion), so when the player walks around within a tile the field isn't touched at all. Tiles from which the
+   target can't be reached (behind a closed door, for instance) have no next tile.
+ */
+
+#ifndef RC_PATHFINDING_H
+#define RC_PATHFINDING_H
+
+#include <cstdint>
+#include <vector>
+
+#include "rcDefines.h"
+#include "rcMap.h"
+
+namespace rcc {
+
+    class FlowField {
+
+    public:
+        // makes the field lead to tile (tx, ty) of the map - the search is only done if the target tile or the walls
+        // changed since the last call. Returns true if it was done
+        bool Update( const Map &map, int tx, int ty ) {
+            if (tx == nTargetX && ty == nTargetY && map.nVersion == nMapVersion && map.mapX == nMapX && map.mapY == nMapY) {
+                return false;
+            }
+            nTargetX = tx;
+            nTargetY = ty;
+            nMapVersion = map.nVersion;
+            nMapX = map.mapX;
+            nMapY = map.mapY;
+            search( map );
+            return true;
+        }
+
+        // the number of steps from tile (x, y) to the target, or -1 if the target can't be reached from there
+        int Distance( int x, int y ) const { return inField( x, y ) ? vDist[Index( x, y )] : -1; }
+
+        // the tile to step to from tile (x, y) - false if (x, y) is the target, or if the target can't be reached
+        bool NextTile( int x, int y, int &nx, int &ny ) const {
+            if (!inField( x, y ) || vNext[Index( x, y )] == NONE) {
+                return false;
+            }
+            int nDir = vNext[Index( x, y )];
+            nx = x + nDirX[nDir];
+            ny = y + nDirY[nDir];
+            return true;
+        }
+
+        int TargetX() const { return nTargetX; }
+        int TargetY() const { return nTargetY; }
+
+    private:
+        static constexpr uint8_t NONE = 255;
+        // the four step directions: east, west, south, north (world y points down)
+        static constexpr int nDirX[4] = { 1, -1, 0,  0 };
+        static constexpr int nDirY[4] = { 0,  0, 1, -1 };
+
+        int nTargetX = -1, nTargetY = -1;
+        int nMapVersion = -1, nMapX = 0, nMapY = 0;
+        std::vector<int>     vDist;    // steps to the target per tile, -1 = unreachable
+        std::vector<uint8_t> vNext;    // direction to step to per tile, NONE = no step
+        std::vector<int>     vQueue;   // tile indices, scratch buffer for the search
+
+        bool inField( int x, int y ) const { return x >= 0 && y >= 0 && x < nMapX && y < nMapY && !vDist.empty(); }
+        int  Index( int x, int y ) const { return y * nMapX + x; }
+
+        void search( const Map &map ) {
+            const size_t nTiles = size_t( nMapX ) * nMapY;
+            vDist.assign( nTiles, -1 );
+            vNext.assign( nTiles, NONE );
+            if (!map.InBounds( nTargetX, nTargetY )) {
+                return;
+            }
+            // the search expands from the target, so the tile a tile was reached from is its next step
+            vQueue.clear();
+            vQueue.reserve( nTiles );
+            vQueue.push_back( Index( nTargetX, nTargetY ));
+            vDist[vQueue[0]] = 0;
+            for (size_t nHead = 0; nHead < vQueue.size(); nHead++) {
+                const int nTile = vQueue[nHead];
+                const int x = nTile % nMapX, y = nTile / nMapX;
+                for (int nDir = 0; nDir < 4; nDir++) {
+                    const int nx = x + nDirX[nDir], ny = y + nDirY[nDir];
+                    if (nx < 0 || ny < 0 || nx >= nMapX || ny >= nMapY) {
+                        continue;
+                    }
+                    const int nNeighbour = Index( nx, ny );
+                    if (vDist[nNeighbour] >= 0 || map.mapW[nNeighbour] != EMPTY) {
+                        continue;
+                    }
+                    vDist[nNeighbour] = vDist[nTile] + 1;
+                    vNext[nNeighbour] = uint8_t( nDir ^ 1 );   // the opposite direction leads back to nTile
+                    vQueue.push_back( nNeighbour );
+                }
+            }
+        }
+    };
+
+} // namespace rcc
+
+#endif // RC_PATHFINDING_H
@@ -0,0 +1,165 @@
+// Render core - ray casting
+// =========================
+
+/* Short description
+   -----------------
+   The DDA ray caster, as a free function on the map, so that it can be used by the renderer (walls, and through the
+   depth buffer the sprite occlusion) as well as by game logic (line of sight, "what's in front of me" queries).
+
+   Episode 3 walks the grid twice per ray - once along the vertical grid lines and once along the horizontal ones -
+   and takes the closest hit, with the start points nudged by 0.0001 to get into the right tile. CastRay() walks the
+   grid once: it keeps the distance along the ray to the next vertical and to the next horizontal grid line, and
+   always steps over the closest one. So the tiles are visited in the order the ray passes them, and the walk stops at
+   the first wall.
+
+   With the distance field of the map (see rcMap.h) the walk skips over the empty square around tiles that are far
+   from any wall. The crossings that are skipped are exactly the ones the plain walk would have stepped over, so the
+   result is the same.
+
+   CastRay() can also record the tiles the ray passes through (up to and including the wall it hits) in a TileSet.
+   Skipping is switched off then, since every tile has to be visited anyway.
+
+   The distances along the ray are of type Scalar, so with RC_FIXED_POINT the walk is done in fixed point (see
+   rcFixed.h).
+ */
+
+#ifndef RC_RAYCAST_H
+#define RC_RAYCAST_H
+
+#include <cmath>
+#include <algorithm>
+
+#include "rcDefines.h"
+#include "rcMap.h"
+#include "rcFixed.h"
+
+namespace rcc {
+
+    struct RayHit {
+        bool  bHit = false;           // false if the ray left the map or went further than the max distance
+        float fDist = 0.0f;           // distance along the ray to the hit (in world units - the direction is normalized)
+        float rx = 0.0f, ry = 0.0f;   // hit point in world coordinates - on a grid line
+        int   mx = 0, my = 0;         // tile that was hit
+        char  cWall = EMPTY;          // its wall type
+        bool  bHorizontal = true;     // hit on a horizontal grid line (north or south side of the tile)
+        float fTexX = 0.0f;           // hit position along the side of the tile [0, 1), left to right in world x or y
+        int   nSkips = 0;             // number of empty squares that were skipped (see the description above)
+    };
+
+    // Casts a ray from (px, py) in direction (fDirX, fDirY) - world coordinates, so with y pointing down. The start
+    // tile itself is not tested. If there's no wall within fMaxDist, or before the ray leaves the map, bHit is false
+    // and fDist is fMaxDist (or the distance to the map border). bSkip enables skipping over empty space, the result
+    // doesn't depend on it. If pVisited isn't nullptr (and has the size of the map), the tiles the ray passes through
+    // are added to it.
+    inline RayHit CastRay( const Map &map, float px, float py, float fDirX, float fDirY, float fMaxDist = 1000000.0f, bool bSkip = true,
+                           TileSet *pVisited = nullptr ) {
+        RayHit hit;
+        const int mapX = map.mapX, mapY = map.mapY;
+        const float fS = float( map.mapS );
+        const float fLen = std::sqrt( fDirX * fDirX + fDirY * fDirY );
+        if (fLen < EPSILON || !map.InBounds( int( std::floor( px / fS )), int( std::floor( py / fS )))) {
+            hit.fDist = 0.0f;
+            return hit;
+        }
+        fDirX /= fLen;
+        fDirY /= fLen;
+        if (pVisited != nullptr && !pVisited->Matches( map.mapX, map.mapY )) {
+            pVisited = nullptr;
+        }
+
+        // tile of the start point, direction of the steps through the grid, the distance along the ray between two
+        // grid lines, and the distance to the first one. The distance to grid line crossing n is dSide0 + n * dDelta
+        // (instead of adding up dDelta, which drifts). Rays parallel to an axis never cross the other axis' lines
+        const Scalar dNever = SCALAR_MAX;
+        int mx = int( std::floor( px / fS )), my = int( std::floor( py / fS ));
+        const int nStepX = fDirX < 0.0f ? -1 : 1, nStepY = fDirY < 0.0f ? -1 : 1;
+        const Scalar dDeltaX = std::fabs( fDirX ) > EPSILON ? ToScalar( fS / std::fabs( fDirX )) : dNever;
+        const Scalar dDeltaY = std::fabs( fDirY ) > EPSILON ? ToScalar( fS / std::fabs( fDirY )) : dNever;
+        const Scalar dSideX0 = std::fabs( fDirX ) > EPSILON ? ToScalar( (nStepX > 0 ? (mx + 1) * fS - px : px - mx * fS) / std::fabs( fDirX )) : dNever;
+        const Scalar dSideY0 = std::fabs( fDirY ) > EPSILON ? ToScalar( (nStepY > 0 ? (my + 1) * fS - py : py - my * fS) / std::fabs( fDirY )) : dNever;
+        const Scalar dMaxDist = ToScalar( fMaxDist );
+        auto side_x = [&]( int n ) { return dSideX0 + n * dDeltaX; };
+        auto side_y = [&]( int n ) { return dSideY0 + n * dDeltaY; };
+        int nX = 0, nY = 0;   // number of vertical and horizontal grid lines crossed
+
+        const uint8_t *pDist = bSkip && pVisited == nullptr && map.occupancy.Matches( mapX, mapY ) ? map.occupancy.GetData() : nullptr;
+        if (pVisited != nullptr) {
+            pVisited->Set( mx, my );
+        }
+        const uint8_t *mapW  = map.mapW.data();
+
+        Scalar dDist;
+        bool bHorizontal;
+        for (;;) {
+            // skip the empty square around the tile (see the description above). All crossings closer than dT are
+            // skipped - the ones of both axes, so that they are a prefix of the order in which the plain walk visits
+            // them. dT is where the ray leaves the square
+            if (pDist != nullptr && pDist[my * mapX + mx] >= SKIP_MIN_DIST) {
+                const int nD = pDist[my * mapX + mx];
+                const int x0 = std::max( mx - nD + 1, 0 ), x1 = std::min( mx + nD, mapX );
+                const int y0 = std::max( my - nD + 1, 0 ), y1 = std::min( my + nD, mapY );
+                Scalar dT = std::min( side_x( nX + (nStepX > 0 ? x1 - 1 - mx : mx - x0)),
+                                     side_y( nY + (nStepY > 0 ? y1 - 1 - my : my - y0)));
+                dT = std::min( dT, dMaxDist );
+                // number of crossings closer than dT - estimated, then corrected with the exact crossing distances
+                int jx = dDeltaX < dNever ? std::max( 0, int( (dT - side_x( nX )) / dDeltaX )) : 0;
+                int jy = dDeltaY < dNever ? std::max( 0, int( (dT - side_y( nY )) / dDeltaY )) : 0;
+                while (jx > 0 && side_x( nX + jx - 1 ) >= dT) { jx--; }
+                while (side_x( nX + jx ) < dT) { jx++; }
+                while (jy > 0 && side_y( nY + jy - 1 ) >= dT) { jy--; }
+                while (side_y( nY + jy ) < dT) { jy++; }
+                int mxs = mx + jx * nStepX, mys = my + jy * nStepY;
+                if (mxs >= x0 && mxs < x1 && mys >= y0 && mys < y1) {
+                    nX += jx; nY += jy;
+                    mx = mxs; my = mys;
+                    hit.nSkips++;
+                }
+            }
+            // step over the closest grid line - the horizontal one on a tie
+            if (side_x( nX ) < side_y( nY )) {
+                dDist = side_x( nX++ );
+                mx += nStepX;
+                bHorizontal = false;
+            } else {
+                dDist = side_y( nY++ );
+                my += nStepY;
+                bHorizontal = true;
+            }
+            if (dDist > dMaxDist || mx < 0 || my < 0 || mx >= mapX || my >= mapY) {
+                hit.fDist = ScalarToFloat( std::min( dDist, dMaxDist ));
+                break;
+            }
+            if (pVisited != nullptr) {
+                pVisited->Set( mx, my );
+            }
+            if (mapW[my * mapX + mx] != EMPTY) {
+                const float fDist = ScalarToFloat( dDist );
+                hit.bHit  = true;
+                hit.fDist = fDist;
+                hit.mx    = mx;
+                hit.my    = my;
+                hit.cWall = char( mapW[my * mapX + mx] );
+                hit.bHorizontal = bHorizontal;
+                // the coordinate across the grid line is exact, the other one follows from the distance
+                if (bHorizontal) {
+                    hit.ry = float( nStepY > 0 ? my : my + 1 ) * fS;
+                    hit.rx = std::min( std::max( px + fDirX * fDist, mx * fS ), (mx + 1) * fS );
+                    hit.fTexX = std::min( (hit.rx - mx * fS) / fS, 0.99999f );
+                } else {
+                    hit.rx = float( nStepX > 0 ? mx : mx + 1 ) * fS;
+                    hit.ry = std::min( std::max( py + fDirY * fDist, my * fS ), (my + 1) * fS );
+                    hit.fTexX = std::min( (hit.ry - my * fS) / fS, 0.99999f );
+                }
+                break;
+            }
+        }
+        if (!hit.bHit) {
+            hit.rx = px + fDirX * hit.fDist;
+            hit.ry = py + fDirY * hit.fDist;
+        }
+        return hit;
+    }
+
+} // namespace rcc
+
+#endif // RC_RAYCAST_H
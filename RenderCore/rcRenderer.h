@@ -0,0 +1,1005 @@
+// Render core - renderer
+// ======================
+
+/* Short description
+   -----------------
+   The ray casting, the wall / floor / ceiling texturing, the sky and the sprite rendering of episode 3, taken out of the
+   AnotherRayCaster class so that it doesn't depend on the PGE anymore. The renderer takes a camera, a map, a texture set
+   and a list of sprites as input, and produces an RGBA frame buffer as output.
+
+   The code is kept as close as possible to the episode 3 code - the only real difference is that all drawing is done
+   into the frame buffer instead of onto the PGE screen.
+
+   The floor and ceiling can be cast in two ways (see SetRowFloor()):
+     * per column (the episode 3 way) - each slice walks down from the bottom of its wall to the bottom of the screen;
+     * per row - after the walls are drawn, the floor and ceiling are cast one screen row at a time. The distance is
+       constant along a row, so the texture coordinates can be stepped incrementally from slice to slice, and the
+       frame buffer is written contiguously. Only the slices that aren't covered by their wall are drawn.
+
+   Distant walls sample a mip level of their texture (see rcTextures.h), picked per slice from the height of the wall:
+   a wall of at most TEX_SIZE / 2 pixels high uses level 1, one of at most TEX_SIZE / 4 pixels level 2, and so on. So
+   they read small, averaged textures instead of skipping texel rows.
+
+   The sky only depends on the player angle. It's expanded once into a panorama at the width of the frame, so drawing
+   it is a copy of (at most) two contiguous pieces of a panorama row per run of pixels. renderFrame() draws it after the
+   walls, floor and ceiling, and only where those left the top half of the screen uncovered: the floor pass records
+   which ceiling pixels it drew, and the walls cover everything from their top down. Rows that are completely covered
+   by ceiling and walls aren't touched at all.
+
+   Together with that, every pixel is written once per frame before the sprites, so renderFrame() doesn't clear the
+   frame buffer: the walls cover their span, the sky and the ceiling cover the rest of the top half, and the floor
+   covers the rest of the bottom half - except outside the map and on tiles without a floor, and on the horizon row of
+   slices without a wall, where the wall and floor passes write the background colour instead.
+
+   The walls write their depth into a depth buffer with one float per pixel column, which the sprites are tested
+   against - one span at a time with a SIMD kernel, so the sprite occlusion is exact at any slice width. Optionally
+   (see SetPixelDepth()) a depth surface of a float per pixel is filled in as well, with the depth of the walls, the
+   floor and the ceiling, for anything that needs to be composited into the 3d view later on. Both hold the
+   perpendicular distance to the camera plane, which is what the sprite projection uses.
+
+   Optionally (see SetTileVisibility()) the rays mark the tiles they pass through (up to the wall they hit) in a tile
+   set while casting - the tiles that are visible in this frame (see GetVisibleTiles()). Sprites in tiles that aren't
+   visible, or next to a visible tile, are then culled before they are projected, and given an entity store with a
+   grid (see rcEntities.h) with at least VIS_MIN_ENTITIES entities, renderFrame() only looks at the entities in and
+   around the visible tiles, so the cost of the sprites doesn't grow with the number of entities in the level. It's
+   off by default: recording the visible tiles switches off the empty space skipping of the ray caster, and costs a
+   clear of a bit per map tile per frame, which only pays off for crowded levels on maps that aren't too big.
+
+   The shading of the walls, the floor and the screens and the colour keyed sprite drawing use the SIMD kernels from
+   rcSimd.h. With RC_FIXED_POINT defined, the ray stepping, the wall texture stepping and the row based floor stepping
+   are done in fixed point (see rcFixed.h).
+
+   The texel and map tile reads of the walls, the floor and the ceiling are bounds checked in debug and sanitizer
+   builds only (see rcChecks.h). The reads that are out of range are skipped and counted, and reported once per frame.
+ */
+
+#ifndef RC_RENDERER_H
+#define RC_RENDERER_H
+
+#include <cmath>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+#include "rcDefines.h"
+#include "rcChecks.h"
+#include "rcFrameBuffer.h"
+#include "rcTextures.h"
+#include "rcMap.h"
+#include "rcRayCast.h"
+#include "rcEntities.h"
+#include "rcWorkerPool.h"
+#include "rcSimd.h"
+
+namespace rcc {
+
+    // -----   SCENE INPUT   -----
+
+    // position and viewing angle of the player
+    struct Camera {
+        float px = 0.0f, py = 0.0f;   // position in world coordinates
+        float pa = 0.0f;              // angle in degrees [0, 360)
+    };
+
+    // time spent in each render stage during the last frame, in milliseconds
+    struct RenderStats {
+        double dSky      = 0.0;
+        double dRaySetup = 0.0;   // setupRays()
+        double dCast     = 0.0;   // the DDA for all slices
+        double dWalls    = 0.0;
+        double dFloor    = 0.0;   // floor and ceiling
+        double dSprites  = 0.0;
+        double dDepth    = 0.0;   // the per pixel depth surface (if enabled)
+        double dTotal    = 0.0;   // the whole renderFrame() call
+        int    nSkips    = 0;     // number of empty squares the ray caster skipped, over all slices (see rcRayCast.h)
+    };
+
+    // ====================   Renderer   ==============================
+
+    class Renderer {
+
+    public:
+        Renderer( int nScreenX = SCREEN_X, int nScreenY = SCREEN_Y, int nSliceWidth = SLICE_WIDTH ) : frame( nScreenX, nScreenY ) {
+            SetResolution( nScreenX, nScreenY, nSliceWidth );
+        }
+
+        // Sets the size of the frame buffer and the width of the slices (in pixels). One ray is cast per slice, so with
+        // a slice width of 1 a ray is cast for every pixel column. The depth buffer and the sprite projection follow
+        // the number of slices. The rays are distributed over a flat camera plane (instead of in fixed angle steps), so
+        // that the projection is correct for any number of rays.
+        void SetResolution( int nScreenX, int nScreenY, int nSliceWidth = SLICE_WIDTH ) {
+            nScrX   = nScreenX;
+            nScrY   = nScreenY;
+            nSliceW = std::max( 1, nSliceWidth );
+            nRays   = (nScrX + nSliceW - 1) / nSliceW;
+            frame.Resize( nScrX, nScrY );
+
+            depthCol.assign( nScrX, DEPTH_FAR );
+            depthPix.assign( bPixelDepth ? size_t( nScrX ) * nScrY : 0, DEPTH_FAR );
+            hits.assign( nRays, RayHit() );
+            wallTop.assign( nRays, nScrY / 2 );
+            wallEnd.assign( nRays, nScrY / 2 );
+            wallBottom.assign( nRays, nScrY );
+            skyCover.assign( size_t( nScrY / 2 ) * nRays, 0 );
+            nSkyStamp = 1;
+            skyPano.clear();   // rebuilt at the new width by the next sky pass
+            spriteTexX.assign( nRays, -1 );
+            spriteRow.assign( nScrX, 0 );
+            rays.assign( nRays, RayInfo() );
+            rayOffset.resize( nRays );
+            rayOffCos.resize( nRays );
+            rayOffSin.resize( nRays );
+            // the camera plane is at distance 1 from the player and spans [-tan( FOV / 2 ), +tan( FOV / 2 )]. Ray r goes
+            // through the center of its slice on that plane - the first ray is the leftmost one (the largest angle)
+            float fPlane = tan( degToRad( 0.5f * FOV ));
+            for (int r = 0; r < nRays; r++) {
+                float fCamX = 1.0f - 2.0f * (r * nSliceW + 0.5f * nSliceW) / float( nScrX );
+                rayOffset[r] = atan( fCamX * fPlane ) * 180.0f / PI;
+                rayOffCos[r] = cos( degToRad( rayOffset[r] ));   // this is also the fish eye correction factor
+                rayOffSin[r] = sin( degToRad( rayOffset[r] ));
+            }
+            // horizontal projection scale (in pixels) that corresponds with the camera plane
+            fFocal  = 0.5f * nScrX / fPlane;
+            // the vertical projection is relative to the original screen height
+            fScaleY = nScrY / float( SCREEN_Y );
+
+            // straight distance (in texture units) from the player to the floor point that is visible on screen row y.
+            // The constant 158 is based on the fov and the aspect ratio since we doubled the view (and it scales with
+            // the screen height). Only the rows below the horizon are used.
+            floorDist.assign( nScrY, 0.0f );
+            for (int y = nScrY / 2 + 1; y < nScrY; y++) {
+                float dy = y - (nScrY / 2.0f);
+                floorDist[y] = 158 * 2 * 32 * fScaleY / dy;
+            }
+            // depth of the floor and ceiling planes per screen row - the floor distance is in texture units, which are
+            // half world units. Floor row y and ceiling row nScrY - y are at the same distance
+            planeDepth.assign( nScrY, DEPTH_FAR );
+            for (int y = nScrY / 2 + 1; y < nScrY; y++) {
+                planeDepth[y] = planeDepth[nScrY - y] = 2.0f * floorDist[y];
+            }
+        }
+
+        int GetScreenWidth()  const { return nScrX;   }
+        int GetScreenHeight() const { return nScrY;   }
+        int GetSliceWidth()   const { return nSliceW; }
+        int GetNrRays()       const { return nRays;   }
+
+        FrameBuffer       &GetFrame()       { return frame; }
+        const FrameBuffer &GetFrame() const { return frame; }
+
+        // renders a complete game frame - the same result as the sequence Clear(), drawSky(), drawRays2D(), drawSprite(),
+        // but every pixel is only written once (before the sprites): the frame isn't cleared, the walls, floor and
+        // ceiling fill in the background colour where they don't draw anything below the horizon, and the sky is drawn
+        // after them where they didn't cover the top half (see drawSkyBehind())
+        void renderFrame( const Camera &cam, const Map &map, const TextureSet &tex, const Sprite *pSprites, int nSprites, uint32_t clearCol ) {
+            auto tFrame = StatsClock::now();
+            nBackground = clearCol;
+            drawRays2D( cam, map, tex );
+            drawSkyBehind( cam, tex );
+            drawSprites( cam, tex, pSprites, nSprites );
+            endFrame();
+            stats.dTotal = msSince( tFrame );
+        }
+        // the same, with the sprites from an entity store - if the visible tiles are recorded and the store has a grid
+        // and at least VIS_MIN_ENTITIES entities, only the entities in and around the visible tiles are considered
+        void renderFrame( const Camera &cam, const Map &map, const TextureSet &tex, const EntityStore &entities, uint32_t clearCol ) {
+            auto tFrame = StatsClock::now();
+            nBackground = clearCol;
+            drawRays2D( cam, map, tex );
+            drawSkyBehind( cam, tex );
+            if (bTileVisibility && entities.Grid().IsSetUp() && entities.Size() >= VIS_MIN_ENTITIES) {
+                auto tStart = StatsClock::now();
+                gatherVisibleEntities( map, entities );
+                double dGather = msSince( tStart );
+                drawSprites( cam, tex, entities.Data(), entities.Size(), candidates.data(), int( candidates.size()));
+                stats.dSprites += dGather;
+            } else {
+                drawSprites( cam, tex, entities.Data(), entities.Size());
+            }
+            endFrame();
+            stats.dTotal = msSince( tFrame );
+        }
+
+        // stage timings of the last frame (each draw function updates its own stages)
+        const RenderStats &GetStats() const { return stats; }
+
+        // the texel and map tile reads that were out of range in the last frame - always zero if the reads aren't
+        // checked (see rcChecks.h)
+        const AccessErrors &GetAccessErrors() const { return accessErrors; }
+        static constexpr bool IsAccessChecked() { return Access::bChecked; }
+
+        // sets the number of threads used for rendering the slices - 1 means serial rendering (the default), 0 means
+        // one thread per hardware thread. The output is identical for any number of threads
+        void SetThreads( int nThreads ) {
+            pPool.reset();
+            if (nThreads != 1) {
+                pPool.reset( new WorkerPool( nThreads ));
+                if (pPool->Threads() == 1) { pPool.reset(); }
+            }
+        }
+        int GetThreads() const { return pPool == nullptr ? 1 : pPool->Threads(); }
+
+        // enables (the default) or disables empty space skipping in the ray caster - the result is the same, it's only
+        // faster on big open maps
+        void SetEmptySpaceSkipping( bool bSkip ) { bSkipEmpty = bSkip; }
+        bool GetEmptySpaceSkipping() const { return bSkipEmpty; }
+
+        // enables or disables (the default) the per pixel depth surface
+        void SetPixelDepth( bool bEnable ) {
+            bPixelDepth = bEnable;
+            depthPix.assign( bPixelDepth ? size_t( nScrX ) * nScrY : 0, DEPTH_FAR );
+        }
+        bool GetPixelDepth() const { return bPixelDepth; }
+
+        // the depth buffers of the last frame: the wall depth per pixel column (GetScreenWidth() floats), and the per
+        // pixel depth surface (GetScreenWidth() x GetScreenHeight() floats, row by row - nullptr if it's not enabled)
+        const float *GetDepthColumns() const { return depthCol.data(); }
+        const float *GetDepthPixels()  const { return bPixelDepth ? depthPix.data() : nullptr; }
+
+        // enables or disables (the default) recording the visible tiles, and the sprite culling based on it - see the
+        // description above
+        void SetTileVisibility( bool bEnable ) { bTileVisibility = bEnable; }
+        bool GetTileVisibility() const { return bTileVisibility; }
+        // the tiles that were visible in the last frame (nullptr if they aren't recorded)
+        const TileSet *GetVisibleTiles() const { return bTileVisibility ? &visibleTiles : nullptr; }
+
+        // selects row based (true) or column based (false, the default) floor and ceiling casting
+        void SetRowFloor( bool bRows ) { bRowFloor = bRows; }
+        bool GetRowFloor() const { return bRowFloor; }
+
+        // the colour drawRays2D() fills in below the horizon where there's no wall or floor (outside the map, or on tiles
+        // without a floor) - renderFrame() sets it to its clear colour
+        void SetBackground( uint32_t col ) { nBackground = col; }
+        uint32_t GetBackground() const { return nBackground; }
+
+        // enables (the default) or disables the mip levels for the walls in the distance (see TextureSet::BuildMips())
+        void SetWallMipmaps( bool bEnable ) { bWallMips = bEnable; }
+        bool GetWallMipmaps() const { return bWallMips; }
+
+        static float degToRad( float angle ) { return angle * PI / 180.0f; }
+        static float FixAng( float angle ) {
+            if (angle >= 360.0f) { angle -= 360.0f; }
+            if (angle <    0.0f) { angle += 360.0f; }
+            return angle;
+        }
+
+    private:
+        FrameBuffer frame;
+
+        // resolution - see SetResolution()
+        int nScrX, nScrY;      // frame buffer size
+        int nSliceW;           // width of a slice in pixels
+        int nRays;             // number of slices (one ray per slice)
+        float fFocal;          // horizontal projection scale in pixels
+        float fScaleY;         // vertical scale relative to SCREEN_Y
+
+        // depth buffers - the wall depth per pixel column, and optionally the depth per pixel (see the description above)
+        std::vector<float> depthCol;
+        std::vector<float> depthPix;
+        bool bPixelDepth = false;
+        // the wall hit of each slice, found by castRay()
+        std::vector<RayHit> hits;
+        // first screen row below the wall of each slice (and below the horizon) - the row floor pass starts there
+        std::vector<int> wallBottom;
+        // the screen rows that the wall of each slice covers: [wallTop, wallEnd)
+        std::vector<int> wallTop, wallEnd;
+        // per pixel of the top half (row by row, a byte per slice): equal to nSkyStamp if the ceiling was drawn there in
+        // this frame. The stamp changes every frame, so the buffer doesn't have to be cleared
+        std::vector<uint8_t> skyCover;
+        uint8_t nSkyStamp = 1;
+        // the sky expanded to the width of the frame, SKY_Y rows (see drawSky()) - and the generation of the sky image
+        // it was made from (see TextureAtlas::Generation())
+        std::vector<uint32_t> skyPano;
+        int nSkyGeneration = 0;
+        bool bRowFloor = false;
+        bool bSkipEmpty = true;
+        bool bWallMips = true;
+        uint32_t nBackground = PackRGB( 0, 0, 0 );
+        // the tiles the rays passed through in this frame, and the tile size of the map they belong to
+        TileSet visibleTiles;
+        bool bTileVisibility = false;
+        int nTileS = TILE_SIZE, nMapX = 0, nMapY = 0;
+        // a sprite that passed the culling in drawSprites(), with its projection and its clipped screen extent
+        struct ProjectedSprite {
+            int   nSprite;          // index in the sprite list
+            float fDepth;           // distance to the camera plane
+            float fScrY;            // screen y of the bottom of the sprite (in slices)
+            int   nScale;           // width and height on screen (in slices)
+            int   xStart;           // slice of texture column 0 (can be off screen)
+            int   xFirst, xLast;    // the slices that are drawn
+        };
+        // scratch buffers for drawSprites() - the sprites to draw, the texture column per slice, and one row of
+        // sprite pixels. When the sprites come from an entity store, candidates are the entities near the visible
+        // tiles, and gathered marks the tiles that have been looked at
+        std::vector<ProjectedSprite> visible;
+        std::vector<int> candidates;
+        TileSet gathered;
+        std::vector<int> spriteTexX;
+        std::vector<uint32_t> spriteRow;
+
+        // per ray values that are set up once per frame in setupRays(), so that there are no trig calls in the
+        // inner loops of the wall, floor and sprite stages
+        struct RayInfo {
+            float ra;           // ray angle in degrees [0, 360)
+            float fCos, fSin;   // cos( ra ), sin( ra )
+            float fTan;         // tan( ra )
+            float fFishEye;     // cos( pa - ra ) - fish eye correction factor
+            float fFloorCos;    // fCos / fFishEye - floor x step per unit of row distance
+            float fFloorSin;    // fSin / fFishEye - floor y step per unit of row distance
+        };
+        std::vector<RayInfo> rays;
+        // angle of each ray relative to the player angle, and its cosine and sine (set up per resolution)
+        std::vector<float> rayOffset, rayOffCos, rayOffSin;
+        // distance to the floor per screen row, and the depth of the floor or ceiling plane per row (set up per resolution)
+        std::vector<float> floorDist;
+        std::vector<float> planeDepth;
+
+        // worker threads for rendering the slices in parallel - nullptr means serial rendering
+        std::unique_ptr<WorkerPool> pPool;
+
+        RenderStats stats;
+        AccessCounters accessCounters;   // out of range reads of the frame that is being rendered
+        AccessErrors   accessErrors;     // ... and of the last frame
+        typedef std::chrono::steady_clock StatsClock;
+        static double msSince( StatsClock::time_point t ) {
+            return std::chrono::duration<double, std::milli>( StatsClock::now() - t ).count();
+        }
+
+        // calls job( r ) for all slices, on the worker pool if there is one
+        template <typename F>
+        void forEachSlice( const F &job ) {
+            if (pPool == nullptr) {
+                for (int r = 0; r < nRays; r++) { job( r ); }
+            } else {
+                pPool->ParallelFor( 0, nRays, std::max( 1, SLICE_GRAIN * SLICE_WIDTH / nSliceW ), [&]( int nBegin, int nEnd ) {
+                    for (int r = nBegin; r < nEnd; r++) { job( r ); }
+                } );
+            }
+        }
+        // calls job( y ) for all floor rows (below the horizon), on the worker pool if there is one. Each floor row y
+        // also draws ceiling row nScrY - y, which is above the horizon - so the rows of different jobs never overlap
+        template <typename F>
+        void forEachFloorRow( const F &job ) {
+            if (pPool == nullptr) {
+                for (int y = nScrY / 2 + 1; y < nScrY; y++) { job( y ); }
+            } else {
+                pPool->ParallelFor( nScrY / 2 + 1, nScrY, ROW_GRAIN, [&]( int nBegin, int nEnd ) {
+                    for (int y = nBegin; y < nEnd; y++) { job( y ); }
+                } );
+            }
+        }
+
+        // pythagoras distance - projected on the ray direction (fCos, fSin)
+        static float distance( float ax, float ay, float bx, float by, float fCos, float fSin ) {
+            return fCos * (bx - ax) - fSin * (by - ay);
+        }
+
+        // takes the out of range reads of the frame, and reports them in one line per frame
+        void endFrame() {
+            if (!Access::bChecked) {
+                return;
+            }
+            accessErrors = accessCounters.Get();
+            accessCounters.Reset();
+            if (accessErrors.Total() > 0) {
+                std::cout << "ERROR: Renderer::renderFrame() --> reads out of range:";
+                for (int k = 0; k < ACCESS_KINDS; k++) {
+                    if (accessErrors.nCount[k] > 0) {
+                        std::cout << " " << AccessKindName( k ) << " x " << accessErrors.nCount[k] << " (first index = " << accessErrors.nFirstIndex[k] << ")";
+                    }
+                }
+                std::cout << std::endl;
+            }
+        }
+
+        // The ray setup stage: works out the direction of all rays for this frame. The ray directions are the
+        // (precomputed) offset directions rotated over the player angle, so only one sin() and cos() are needed per frame
+        void setupRays( const Camera &cam ) {
+            float fCosPA = cos( degToRad( cam.pa ));
+            float fSinPA = sin( degToRad( cam.pa ));
+            for (int r = 0; r < nRays; r++) {
+                RayInfo &ray = rays[r];
+                ray.ra        = FixAng( cam.pa + rayOffset[r] );    // make sure ra is in [0, 360)
+                ray.fCos      = fCosPA * rayOffCos[r] - fSinPA * rayOffSin[r];
+                ray.fSin      = fSinPA * rayOffCos[r] + fCosPA * rayOffSin[r];
+                ray.fTan      = ray.fSin / ray.fCos;
+                ray.fFishEye  = rayOffCos[r];
+                ray.fFloorCos = ray.fCos / ray.fFishEye;
+                ray.fFloorSin = ray.fSin / ray.fFishEye;
+            }
+        }
+
+    public:
+        // The ray casting and the rendering of the textured walls, floor and ceiling is done in stages, that each run
+        // over all slices (in parallel if a worker pool is set):
+        //   * castRay()         - the DDA ray casting algorithm, finds the wall hit of each slice
+        //   * drawWall()        - renders the wall of each slice
+        //   * drawFloorColumn() - renders the floor and ceiling of each slice, or with row floor casting drawFloorRow()
+        //                         renders them per screen row
+        void drawRays2D( const Camera &cam, const Map &map, const TextureSet &tex ) {
+
+            // prepare iteration over field of view - one ray is cast for every slice. The rays are set up front, so
+            // that the slices can be rendered in any order
+            auto tStart = StatsClock::now();
+            setupRays( cam );
+            stats.dRaySetup = msSince( tStart );
+
+            tStart = StatsClock::now();
+            nTileS = map.mapS;
+            nMapX  = map.mapX;
+            nMapY  = map.mapY;
+            if (bTileVisibility) {
+                if (visibleTiles.Matches( map.mapX, map.mapY )) {
+                    visibleTiles.Clear();
+                } else {
+                    visibleTiles.Resize( map.mapX, map.mapY );
+                }
+            }
+            forEachSlice( [&]( int r ) { castRay( r, rays[r], cam, map ); } );
+            stats.dCast = msSince( tStart );
+            stats.nSkips = 0;
+            for (int r = 0; r < nRays; r++) {
+                stats.nSkips += hits[r].nSkips;
+            }
+
+            tStart = StatsClock::now();
+            forEachSlice( [&]( int r ) { drawWall( r, rays[r], map, tex ); } );
+            stats.dWalls = msSince( tStart );
+
+            tStart = StatsClock::now();
+            if (++nSkyStamp == 0) {   // the stamp wrapped around - the old marks have to go
+                std::fill( skyCover.begin(), skyCover.end(), 0 );
+                nSkyStamp = 1;
+            }
+            if (bRowFloor) {
+                forEachFloorRow( [&]( int y ) { drawFloorRow( y, cam, map, tex ); } );
+            } else {
+                forEachSlice( [&]( int r ) { drawFloorColumn( r, rays[r], cam, map, tex ); } );
+            }
+            stats.dFloor = msSince( tStart );
+
+            tStart = StatsClock::now();
+            if (bPixelDepth) {
+                forEachSlice( [&]( int r ) { drawDepth( r ); } );
+            }
+            stats.dDepth = msSince( tStart );
+        }
+
+        // fills the columns of slice r of the per pixel depth surface: the depth of the wall on the rows it covers, and
+        // the depth of the floor and ceiling planes on the other rows
+        void drawDepth( int r ) {
+            const int nSliceX = r * nSliceW;
+            const int nSpanW  = std::min( nSliceW, nScrX - nSliceX );
+            const float fWall = depthCol[nSliceX];
+            for (int y = 0; y < nScrY; y++) {
+                float *pDst = depthPix.data() + size_t( y ) * nScrX + nSliceX;
+                std::fill( pDst, pDst + nSpanW, (y >= wallTop[r] && y < wallEnd[r]) ? fWall : planeDepth[y] );
+            }
+        }
+
+        // casts the ray for slice r and stores the wall hit in hits[r], and marks the tiles the ray passes in the
+        // visible tiles. Each slice only writes its own entry (and TileSet::Set() is thread safe), so slices can be
+        // cast concurrently
+        void castRay( int r, const RayInfo &ray, const Camera &cam, const Map &map ) {
+            // the direction in world coordinates - the y axis points down
+            RayHit &hit = hits[r];
+            hit = CastRay( map, cam.px, cam.py, ray.fCos, -ray.fSin, 1000000.0f, bSkipEmpty, bTileVisibility ? &visibleTiles : nullptr );
+        }
+
+        // collects the handles of the entities in and around the visible tiles in candidates - a sprite can stick out
+        // of its tile, so the neighbours of the visible tiles are included
+        void gatherVisibleEntities( const Map &map, const EntityStore &entities ) {
+            candidates.clear();
+            if (gathered.Matches( map.mapX, map.mapY )) {
+                gathered.Clear();
+            } else {
+                gathered.Resize( map.mapX, map.mapY );
+            }
+            const SpatialGrid &grid = entities.Grid();
+            visibleTiles.ForEach( [&]( int tx, int ty ) {
+                for (int y = std::max( ty - 1, 0 ); y <= std::min( ty + 1, map.mapY - 1 ); y++) {
+                    for (int x = std::max( tx - 1, 0 ); x <= std::min( tx + 1, map.mapX - 1 ); x++) {
+                        if (!gathered.Test( x, y )) {
+                            gathered.Set( x, y );
+                            grid.ForEachInTile( x, y, [&]( int h ) { candidates.push_back( h ); } );
+                        }
+                    }
+                }
+            } );
+        }
+
+        // renders the wall of slice r, using the hit that castRay() found, and writes its depth. Each slice only
+        // writes its own columns of the frame buffer and the depth buffer, and its own wallTop[] etc. entries
+        void drawWall( int r, const RayInfo &ray, const Map &map, const TextureSet &tex ) {
+
+            const float ra = ray.ra;
+            const int mapS = map.mapS;
+
+            // the screen columns of this slice - the last slice may be narrower if the screen width isn't a multiple
+            // of the slice width
+            const int nSliceX = r * nSliceW;
+            const int nSpanW  = std::min( nSliceW, nScrX - nSliceX );
+
+            const RayHit &hit = hits[r];
+            const int nHitTile = hit.bHit ? map.Index( hit.mx, hit.my ) : -1;
+            if (!hit.bHit || !Access::InRange( accessCounters, ACCESS_MAP_TILE, nHitTile, map.mapX * map.mapY )) {
+                // the ray left the map - no wall to draw, the horizon row shows the background
+                std::fill( depthCol.begin() + nSliceX, depthCol.begin() + nSliceX + nSpanW, DEPTH_FAR );
+                wallTop[r] = wallEnd[r] = nScrY / 2;
+                wallBottom[r] = nScrY / 2 + 1;
+                fillBackground( nSliceX, nSpanW, nScrY / 2, nScrY / 2 + 1 );
+                return;
+            }
+            const int nTexOffset = map.texW[nHitTile];   // the texture of the wall that was hit
+            const bool bHitHorizontal = hit.bHorizontal;
+            const float fShadeFactor = bHitHorizontal ? 1.0f : 0.5f;   // shade the vertical walls
+
+            // ----- Draw 3D walls -----
+            //       =============
+
+            float disH = hit.fDist * ray.fFishEye;                                // fix fish eye distortion
+            std::fill( depthCol.begin() + nSliceX, depthCol.begin() + nSliceX + nSpanW, disH );
+
+            float lineH = (mapS * nScrY) / disH;
+
+            // calculate step formula before line height is capped
+            float ty_step = 32.0f / (float)lineH;
+            float ty_off = 0.0f;
+
+            if (lineH > nScrY) { ty_off = (lineH - nScrY) / 2.0f; lineH = nScrY; }      // cap line height at screen height
+            float lineOff = (nScrY / 2) - lineH / 2.0f;          // offset from top of screen
+
+            // put slice on screen - textured rendering
+            float ty = ty_off * ty_step;
+            float tx = int( hit.fTexX * 32.0f );   // the hit position along the wall, in texels
+            if (bHitHorizontal) {
+                if (ra > 180           ) { tx = 31 - tx; } // south textures are mirrored, flip them
+            } else {
+                if (90 < ra && ra < 270) { tx = 31 - tx; } // west textures are mirrored, flip them
+            }
+
+            // pick the mip level: the first level on which the wall steps less than 2 texel rows per screen row. A wall of
+            // at most 16 pixels high would skip texel rows of the full size texture, it uses level 1 - one of at most 8
+            // pixels uses level 2, and so on. Level L has tiles of 32 >> L texels, so all texel coordinates and offsets
+            // scale down
+            int nLevel = 0;
+            if (bWallMips) {
+                const int nLevels = tex.MipLevels();
+                while (nLevel < nLevels && ty_step >= float( 2 << nLevel )) { nLevel++; }
+            }
+            const TextureAtlas &level = nLevel == 0 ? tex.textures : tex.mips[nLevel - 1];
+            const int   nLevelSize  = TEX_SIZE >> nLevel;
+            const float fLevelScale = 1.0f / float( 1 << nLevel );
+
+            // display the wall using texture column tx of the level - the slice is written straight into the frame
+            // buffer, one slice wide span per screen row. The texture rows stay within the tile, since ty < 32
+            int nColumn = (int( tx ) >> nLevel) + (nTexOffset >> (2 * nLevel));
+
+            // the whole texture column has to be within the texture atlas
+            const int nColumnEnd = level.Width() * level.Height() - (nLevelSize - 1) * nLevelSize;
+            const bool bTexelsOk = Access::InRange( accessCounters, ACCESS_WALL_TEXEL, nColumn, nColumnEnd );
+            if (bTexelsOk) {
+#if defined( RC_FIXED_POINT )
+                ShadeStrip( frame.Row( int( lineOff )) + nSliceX, frame.Stride(), nSpanW, int( std::ceil( lineH )),
+                            level.GetData() + nColumn, FloatToFix( ty * fLevelScale ), FloatToFix( ty_step * fLevelScale ), fShadeFactor, nLevelSize );
+#else
+                ShadeStrip( frame.Row( int( lineOff )) + nSliceX, frame.Stride(), nSpanW, int( std::ceil( lineH )),
+                            level.GetData() + nColumn, ty * fLevelScale, ty_step * fLevelScale, fShadeFactor, nLevelSize );
+#endif
+            }
+
+            // the floor starts below the wall
+            wallTop[r] = int( lineOff );
+            wallEnd[r] = int( lineOff ) + int( std::ceil( lineH ));
+            wallBottom[r] = std::max( int( lineOff + lineH ), nScrY / 2 + 1 );
+
+            // the rows that nothing else draws: the wall if it couldn't be drawn, and (for walls less than 2 pixels
+            // high) the horizon row between the wall and the floor
+            if (!bTexelsOk) {
+                fillBackground( nSliceX, nSpanW, wallTop[r], wallEnd[r] );
+            }
+            fillBackground( nSliceX, nSpanW, std::max( wallEnd[r], nScrY / 2 ), wallBottom[r] );
+        }
+
+        // fills rows [y0, y1) of screen columns [x, x + nW) with the background colour
+        void fillBackground( int x, int nW, int y0, int y1 ) {
+            for (int y = y0; y < y1; y++) {
+                FrameBuffer::FillSpan( frame.Row( y ) + x, nW, nBackground );
+            }
+        }
+
+        // fills slice r of floor row y (pRow) with the background colour where no floor is drawn - except on the last
+        // row of the wall: a wall that doesn't end on a pixel boundary shares that row with the floor, which only draws
+        // over the wall where there is a floor texel
+        void fillFloorBackground( uint32_t *pRow, int r, int y ) {
+            if (y >= wallEnd[r]) {
+                const int nSliceX = r * nSliceW;
+                FrameBuffer::FillSpan( pRow + nSliceX, std::min( nSliceW, nScrX - nSliceX ), nBackground );
+            }
+        }
+
+        // renders the floor and ceiling of slice r, from the bottom of its wall down. Each slice only writes its own
+        // columns of the frame buffer
+        void drawFloorColumn( int r, const RayInfo &ray, const Camera &cam, const Map &map, const TextureSet &tex ) {
+
+            const float px = cam.px, py = cam.py;
+            const int mapX = map.mapX;
+            const int32_t *texF = map.texF.data();
+            const int32_t *texC = map.texC.data();
+            // the floor and ceiling are only drawn within the map - the texture coordinates are half world coordinates
+            const float fMapW = mapX * 32.0f, fMapH = map.mapY * 32.0f;
+            const uint32_t *All_Textures = tex.textures.GetData();
+            const int nTiles  = mapX * map.mapY;
+            const int nTexels = tex.textures.Width() * tex.textures.Height();
+
+            const int nSliceX = r * nSliceW;
+            const int nSpanW  = std::min( nSliceW, nScrX - nSliceX );
+
+            // ----- Draw Floor -----
+            //       ==========
+
+            // work your way down from bottom of wall
+            for (int y = wallBottom[r]; y < nScrY; y++) {
+                // determine texture coordinates - using the per row floor distance, and the per ray direction
+                // (that is already corrected for fish eye)
+                float tx = px / 2.0f + ray.fFloorCos * floorDist[y];
+                float ty = py / 2.0f - ray.fFloorSin * floorDist[y];
+
+                if (tx < 0.0f || ty < 0.0f || tx >= fMapW || ty >= fMapH) {
+                    fillFloorBackground( frame.Row( y ), r, y );
+                    continue;   // outside the map
+                }
+
+                // sample floor - tiles without a (known) floor type show the background
+                int nTile = int( ty / 32.0f ) * mapX + int( tx / 32.0f );
+                if (!Access::InRange( accessCounters, ACCESS_MAP_TILE, nTile, nTiles )) {
+                    fillFloorBackground( frame.Row( y ), r, y );
+                    continue;
+                }
+                int nmp = texF[ nTile ];
+                int nPixel = ((int( ty ) & 31) * 32 + (int( tx ) & 31)) + nmp;
+                if (nmp >= 0 && Access::InRange( accessCounters, ACCESS_FLOOR_TEXEL, nPixel, nTexels )) {
+                    uint32_t texel = All_Textures[nPixel];
+                    int red   = GetR( texel ) * 0.7f;  // darken floor a little bit just to add variation
+                    int green = GetG( texel ) * 0.7f;
+                    int blue  = GetB( texel ) * 0.7f;
+                    // draw "pixels" as slice wide spans
+                    FrameBuffer::FillSpan( frame.Row( y ) + nSliceX, nSpanW, PackRGB( red, green, blue ));
+                } else {
+                    fillFloorBackground( frame.Row( y ), r, y );
+                }
+
+                // ----- Draw ceiling -----
+                //       ============
+
+                // sample ceiling
+                nmp = texC[ nTile ];
+                // tiles without a ceiling are not drawn - so we can see the sky there
+                nPixel = ((int( ty ) & 31) * 32 + (int( tx ) & 31)) + nmp;
+                if (nmp >= 0 && Access::InRange( accessCounters, ACCESS_CEIL_TEXEL, nPixel, nTexels )) {
+                    // draw "pixels" as slice wide spans - the ceiling isn't shaded, so the texel is copied as is
+                    FrameBuffer::FillSpan( frame.Row( nScrY - y ) + nSliceX, nSpanW, All_Textures[nPixel] );
+                    markCeiling( nScrY - y, r );
+                }
+            }
+        }
+
+        // Casts floor row y (below the horizon) and the mirrored ceiling row nScrY - y, for all slices that aren't
+        // covered by their wall. All floor points on a row are at the same distance, and the floor direction of the
+        // rays is linear over the camera plane, so the texture coordinates are stepped with a constant increment
+        void drawFloorRow( int y, const Camera &cam, const Map &map, const TextureSet &tex ) {
+
+            const int mapX = map.mapX;
+            const int32_t *texF = map.texF.data();
+            const int32_t *texC = map.texC.data();
+            const Scalar dMapW = ToScalar( mapX * 32.0f ), dMapH = ToScalar( map.mapY * 32.0f );
+            const Scalar dZero = ToScalar( 0.0f );
+            const uint32_t *All_Textures = tex.textures.GetData();
+            const int nTiles  = mapX * map.mapY;
+            const int nTexels = tex.textures.Width() * tex.textures.Height();
+
+            // texture coordinates of the first slice, and the step per slice - in fixed point with RC_FIXED_POINT
+            const float fDist = floorDist[y];
+            Scalar tx = ToScalar( cam.px / 2.0f + rays[0].fFloorCos * fDist );
+            Scalar ty = ToScalar( cam.py / 2.0f - rays[0].fFloorSin * fDist );
+            Scalar tx_step = dZero, ty_step = dZero;
+            if (nRays > 1) {
+                tx_step = ToScalar(  (rays[nRays - 1].fFloorCos - rays[0].fFloorCos) * fDist / (nRays - 1));
+                ty_step = ToScalar( -(rays[nRays - 1].fFloorSin - rays[0].fFloorSin) * fDist / (nRays - 1));
+            }
+
+            uint32_t *pFloor = frame.Row( y );
+            uint32_t *pCeil  = frame.Row( nScrY - y );
+
+            // the floor texels of a run of consecutive slices are gathered, and then shaded and written in one go
+            const int nChunk = 64;
+            uint32_t buf[nChunk];
+            int nRun = 0, nRunStart = 0;
+            auto flush_run = [&]() {
+                if (nSliceW == 1) {
+                    Simd().ShadeSpan( pFloor + nRunStart, buf, nRun, 0.7f );   // darken floor a little bit just to add variation
+                } else {
+                    Simd().ShadeSpan( buf, buf, nRun, 0.7f );
+                    for (int i = 0; i < nRun; i++) {
+                        int nSliceX = (nRunStart + i) * nSliceW;
+                        FrameBuffer::FillSpan( pFloor + nSliceX, std::min( nSliceW, nScrX - nSliceX ), buf[i] );
+                    }
+                }
+                nRun = 0;
+            };
+
+            for (int r = 0; r < nRays; r++, tx += tx_step, ty += ty_step) {
+                if (y < wallBottom[r]) {
+                    flush_run();
+                    continue;   // this part of the row is covered by the wall of slice r
+                }
+                const int nSliceX = r * nSliceW;
+                const int nSpanW  = std::min( nSliceW, nScrX - nSliceX );
+
+                if (tx < dZero || ty < dZero || tx >= dMapW || ty >= dMapH) {
+                    flush_run();
+                    fillFloorBackground( pFloor, r, y );
+                    continue;   // outside the map
+                }
+                int itx = ScalarToInt( tx ), ity = ScalarToInt( ty );
+                int nTile = (ity / 32) * mapX + itx / 32;
+                int nTexel = (ity & 31) * 32 + (itx & 31);
+                if (!Access::InRange( accessCounters, ACCESS_MAP_TILE, nTile, nTiles )) {
+                    flush_run();
+                    fillFloorBackground( pFloor, r, y );
+                    continue;
+                }
+
+                // sample floor - tiles without a (known) floor type show the background
+                int nFloor = texF[ nTile ];
+                int nPixel = nTexel + nFloor;
+                if (nFloor < 0 || !Access::InRange( accessCounters, ACCESS_FLOOR_TEXEL, nPixel, nTexels )) {
+                    flush_run();
+                    fillFloorBackground( pFloor, r, y );
+                } else {
+                    if (nRun == 0) { nRunStart = r; }
+                    buf[nRun++] = All_Textures[nPixel];
+                    if (nRun == nChunk) { flush_run(); }
+                }
+
+                // sample ceiling - tiles without a ceiling are not drawn, so we can see the sky there
+                int nmp = texC[ nTile ];
+                if (nmp >= 0 && Access::InRange( accessCounters, ACCESS_CEIL_TEXEL, nTexel + nmp, nTexels )) {
+                    FrameBuffer::FillSpan( pCeil + nSliceX, nSpanW, All_Textures[nTexel + nmp] );
+                    markCeiling( nScrY - y, r );
+                }
+            }
+            flush_run();
+        }
+
+        // records that the ceiling was drawn on pixel row y of slice r - for the sky pass
+        void markCeiling( int y, int r ) {
+            if (y < nScrY / 2) {
+                skyCover[size_t( y ) * nRays + r] = nSkyStamp;
+            }
+        }
+
+        // (re)builds the sky panorama if the frame width changed or the sky image was (re)loaded. Panorama column p shows sky column
+        // SKY_X - p * SKY_X / nScrX (wrapped) - the sky runs from right to left, since it shifts against the angle
+        void updateSkyPanorama( const TextureSet &tex ) {
+            if (!skyPano.empty() && nSkyGeneration == tex.sky.Generation()) {
+                return;
+            }
+            nSkyGeneration = tex.sky.Generation();
+            skyPano.resize( size_t( nScrX ) * SKY_Y );
+            for (int ty = 0; ty < SKY_Y; ty++) {
+                for (int p = 0; p < nScrX; p++) {
+                    int xo = (SKY_X - p * SKY_X / nScrX) % SKY_X;
+                    skyPano[size_t( ty ) * nScrX + p] = tex.sky.FetchImage( xo, ty );
+                }
+            }
+        }
+
+        // the offset in the panorama of screen column 0. The sky shifts 2 sky columns per degree - shifting by nShift
+        // sky columns is a shift over nShift * nScrX / SKY_X pixels, which is exact if the width is a multiple of
+        // SKY_X (like the default 960), and rounded otherwise
+        int skyOffset( const Camera &cam ) const {
+            int nShift = ((int( cam.pa ) * 2) % SKY_X + SKY_X) % SKY_X;
+            int nShiftX = nShift * nScrX / SKY_X;
+            return (nScrX - nShiftX) % nScrX;
+        }
+
+        // copies screen columns [x0, x1) of a sky row from panorama row pPano - wrapped, so at most two pieces
+        void copySkySpan( uint32_t *pDst, const uint32_t *pPano, int nOffset, int x0, int x1 ) const {
+            int nSrc = (x0 + nOffset) % nScrX;
+            int nLen = x1 - x0;
+            int nFirst = std::min( nLen, nScrX - nSrc );
+            std::memcpy( pDst + x0, pPano + nSrc, nFirst * sizeof( uint32_t ));
+            if (nLen > nFirst) {
+                std::memcpy( pDst + x0 + nFirst, pPano, (nLen - nFirst) * sizeof( uint32_t ));
+            }
+        }
+
+        // the SKY_X x SKY_Y sky texels are stretched over the top half of the screen - at 960 x 640 each texel
+        // is an 8 x 8 block. The sky is copied from the panorama, a row at a time
+        void drawSky( const Camera &cam, const TextureSet &tex ) {
+            auto tStart = StatsClock::now();
+            updateSkyPanorama( tex );
+
+            const int nSkyH = nScrY / 2;
+            const int nOffset = skyOffset( cam );
+            for (int y = 0; y < nSkyH; y++) {
+                copySkySpan( frame.Row( y ), skyPano.data() + size_t( y * SKY_Y / nSkyH ) * nScrX, nOffset, 0, nScrX );
+            }
+            stats.dSky = msSince( tStart );
+        }
+
+        // draws the sky on the pixels of the top half that the last drawRays2D() didn't cover - the ones outside the
+        // wall of their slice, where no ceiling was drawn. Runs of such slices are copied from the panorama in one go,
+        // and rows that are covered completely are skipped
+        void drawSkyBehind( const Camera &cam, const TextureSet &tex ) {
+            auto tStart = StatsClock::now();
+            updateSkyPanorama( tex );
+
+            const int nSkyH = nScrY / 2;
+            const int nOffset = skyOffset( cam );
+            for (int y = 0; y < nSkyH; y++) {
+                uint32_t *pDst = frame.Row( y );
+                const uint32_t *pPano = skyPano.data() + size_t( y * SKY_Y / nSkyH ) * nScrX;
+                const uint8_t *pCover = skyCover.data() + size_t( y ) * nRays;
+                int r = 0;
+                while (r < nRays) {
+                    // skip the covered slices, then find the end of the run of open ones
+                    while (r < nRays && ((y >= wallTop[r] && y < wallEnd[r]) || pCover[r] == nSkyStamp)) { r++; }
+                    int rStart = r;
+                    while (r < nRays && !((y >= wallTop[r] && y < wallEnd[r]) || pCover[r] == nSkyStamp)) { r++; }
+                    if (r > rStart) {
+                        copySkySpan( pDst, pPano, nOffset, rStart * nSliceW, std::min( r * nSliceW, nScrX ));
+                    }
+                }
+            }
+            stats.dSky = msSince( tStart );
+        }
+
+        // draws the sprites that are "on" - this method only renders, the game logic for the sprites (pick up,
+        // enemy attack) is the responsibility of the caller.
+        // First all sprites are projected once: the ones behind the camera, outside of the view or completely hidden
+        // behind the walls are culled, and for the others the slices they cover are clipped to the screen and to the
+        // walls in front of them. The remaining sprites are drawn back to front, so that closer sprites cover the ones
+        // further away.
+        // A sprite is drawn one texel row at a time: the texels of the row are expanded into a row of pixels, the pixel
+        // columns where the sprite is behind a wall are set to magenta, and the row is then blitted colour keyed for
+        // each screen row the texel row covers
+        // If pHandles isn't nullptr, only the nHandles sprites sp[pHandles[i]] are considered.
+        void drawSprites( const Camera &cam, const TextureSet &tex, const Sprite *sp, int nSprites, const int *pHandles = nullptr, int nHandles = 0 ) {
+            auto tStart = StatsClock::now();
+            const float px = cam.px, py = cam.py, pa = cam.pa;
+            const uint32_t nMagenta = PackRGB( 255, 0, 255 );
+            // to rotate the sprites around the player - need players position with sine and cosine (once per frame)
+            const float CS = cos( degToRad( pa )), SN = sin( degToRad( pa ));
+
+            visible.clear();
+            const int nCount = pHandles != nullptr ? nHandles : nSprites;
+            for (int i = 0; i < nCount; i++) {
+                const int s = pHandles != nullptr ? pHandles[i] : i;
+                // only draw the sprite if it's "on"
+                if (sp[s].state != 1) {
+                    continue;
+                }
+                // culled if its tile is on the map, but not visible or next to a visible tile
+                if (bTileVisibility && visibleTiles.Matches( nMapX, nMapY )) {
+                    int tx = int( std::floor( sp[s].x / nTileS )), ty = int( std::floor( sp[s].y / nTileS ));
+                    if (tx >= 0 && ty >= 0 && tx < nMapX && ty < nMapY && !visibleTiles.TestNear( tx, ty )) {
+                        continue;
+                    }
+                }
+                // work out temp value of sprite position -/- player position
+                float sx = sp[s].x - px;
+                float sy = sp[s].y - py;
+                float sz = sp[s].z;
+                // rotate the sprite around the player
+                float a = sy * CS + sx * SN;   // "rotation matrix"
+                float b = sx * CS - sy * SN;
+                // behind the camera
+                if (b <= 0.0f) {
+                    continue;
+                }
+                sx = a;
+                sy = b;
+
+                // "multiply by a large constant and divide by our screen depth
+                // reposition that in the center of our screen using half the screen width and height
+                // NOTE: screen x, y are in slices (nSliceW x nSliceW blocks), the horizontal projection follows the
+                //       camera plane, the vertical projection scales with the screen height
+                sx = (sx * fFocal                        / (sy * nSliceW)) + (nScrX / (2.0f * nSliceW));   // convert to screen x, y
+                sy = (sz * 108.0f * SLICE_WIDTH * fScaleY / (sy * nSliceW)) + ((nScrY / nSliceW) / 2);
+
+                // scale according to z-depth - set limits to prevent scale too big
+                int scale = int( std::min( float( nRays ), 32 * 80 * SLICE_WIDTH * fScaleY / (b * nSliceW)));
+
+                // the sprite covers the slices xStart up to (not including) sx + scale / 2 - only the slices that are
+                // on screen are drawn. Outside of the view the sprite is culled
+                if (scale == 0 || sx + scale / 2 <= 1.0f || sx - scale / 2 >= float( nRays )) {
+                    continue;
+                }
+                ProjectedSprite ps;
+                ps.nSprite = s;
+                ps.fDepth  = b;
+                ps.fScrY   = sy;
+                ps.nScale  = scale;
+                ps.xStart  = int( sx - scale / 2 );
+                ps.xFirst  = std::max( ps.xStart, 1 );
+                ps.xLast   = std::min( int( std::ceil( sx + scale / 2 )) - 1, nRays - 1 );
+                // clip the slices at either end where the sprite is behind the wall (the depth is the same for all
+                // pixel columns of a slice) - if that's all of them, the sprite is hidden
+                while (ps.xFirst <= ps.xLast && !(b < depthCol[ps.xFirst * nSliceW])) { ps.xFirst++; }
+                while (ps.xFirst <= ps.xLast && !(b < depthCol[ps.xLast  * nSliceW])) { ps.xLast--;  }
+                if (ps.xFirst > ps.xLast) {
+                    continue;
+                }
+                visible.push_back( ps );
+            }
+            // back to front - sprites at the same depth in the order of the list
+            std::sort( visible.begin(), visible.end(), []( const ProjectedSprite &l, const ProjectedSprite &r ) {
+                return l.fDepth > r.fDepth || (l.fDepth == r.fDepth && l.nSprite < r.nSprite);
+            } );
+
+            for (const ProjectedSprite &ps : visible) {
+                const float b = ps.fDepth, sy = ps.fScrY;
+                const int scale = ps.nScale;
+                // texture
+                const uint32_t *pTex = tex.sprites.GetData() + sp[ps.nSprite].nMap * TEX_SIZE * TEX_SIZE;
+                float t_y = 31;
+                float t_x_step = 31.5f / float( scale );   // height of texture divided by scale (rounding issue fixed)
+                float t_y_step = 32.0f / float( scale );
+
+                // the texture column of each slice the sprite covers
+                for (int x = ps.xFirst; x <= ps.xLast; x++) {
+                    spriteTexX[x] = int( (x - ps.xStart) * t_x_step );
+                }
+                // the pixel columns of those slices (the last slice may be narrower than nSliceW)
+                const int nPixX0 = ps.xFirst * nSliceW;
+                const int nPixW  = std::min( (ps.xLast + 1) * nSliceW, nScrX ) - nPixX0;
+
+                for (int y = 0; y < scale; y++, t_y = std::max( t_y - t_y_step, 0.0f )) {
+                    // the block is only clipped vertically, since x is already clipped to the screen
+                    int y0 = std::max( int( (sy - y) * nSliceW ), 0 );
+                    int y1 = std::min( int( (sy - y) * nSliceW ) + nSliceW, nScrY );
+                    if (y0 >= y1) {
+                        continue;
+                    }
+                    // expand this texel row into a row of pixels - apply colour filtering on pure magenta, both for
+                    // the transparent texels and for the pixel columns where the sprite is behind a wall
+                    const uint32_t *pTexRow = pTex + int( t_y ) * TEX_SIZE;
+                    for (int x = ps.xFirst; x <= ps.xLast; x++) {
+                        int nPixX = x * nSliceW - nPixX0;
+                        FrameBuffer::FillSpan( spriteRow.data() + nPixX, std::min( nSliceW, nPixW - nPixX ), pTexRow[spriteTexX[x]] );
+                    }
+                    Simd().DepthTest( spriteRow.data(), depthCol.data() + nPixX0, nPixW, b, nMagenta );
+                    for (int yy = y0; yy < y1; yy++) {
+                        Simd().BlitKeyed( frame.Row( yy ) + nPixX0, spriteRow.data(), nPixW, nMagenta );
+                    }
+                }
+            }
+            stats.dSprites = msSince( tStart );
+        }
+
+        // draws a full screen picture (title, won or lost screen) with fade factor in [0.0f, 1.0f] - the picture is
+        // stretched to the frame buffer size if needed
+        void drawScreen( const TextureAtlas &T, float fade ) {
+            for (int y = 0; y < nScrY; y++) {
+                uint32_t *pDst = frame.Row( y );
+                const uint32_t *pSrc = T.Row( y * T.Height() / nScrY );
+                // display the screen using the selected texture, using 1x1 pixels - stretch the row first if needed
+                if (T.Width() != nScrX) {
+                    for (int x = 0; x < nScrX; x++) {
+                        pDst[x] = pSrc[x * T.Width() / nScrX];
+                    }
+                    pSrc = pDst;
+                }
+                Simd().ShadeSpan( pDst, pSrc, nScrX, fade );
+            }
+        }
+    };
+
+} // namespace rcc
+
+#endif // RC_RENDERER_H
@@ -0,0 +1,281 @@
+// Render core - SIMD kernels
+// ==========================
+
+/* Short description
+   -----------------
+   The inner loops of the renderer shade texels one colour channel at a time (int -> float -> int), and key out the
+   magenta sprite texels one texel at a time. This file has SSE2 and AVX2 versions of these kernels, next to a plain
+   scalar version. The best version that the CPU supports is selected at runtime (the first time the kernels are used),
+   so one executable runs on any x86 CPU. Other platforms, and builds with RC_NO_SIMD defined, use the scalar version.
+
+   The kernels work on spans of packed pixels:
+     * ShadeSpan() - multiplies the r, g and b channels by a factor (truncating, like the scalar code) and sets alpha
+                     to 255. It's used for the wall shading, the floor darkening and the screen fades;
+     * BlitKeyed() - copies all pixels that differ from a key colour. It's used for the sprites;
+     * DepthTest() - replaces the pixels that are not in front of a depth span by the key colour, so that a following
+                     BlitKeyed() skips them. It's used for the sprite occlusion.
+
+   The SIMD versions do exactly the same float operations as the scalar version, so the output is bit identical.
+ */
+
+#ifndef RC_SIMD_H
+#define RC_SIMD_H
+
+#include <cstdint>
+#include <algorithm>
+
+#include "rcDefines.h"
+#include "rcFrameBuffer.h"
+#include "rcFixed.h"
+
+#if !defined( RC_NO_SIMD ) && (defined( __x86_64__ ) || defined( _M_X64 ) || defined( __i386__ ) || defined( _M_IX86 ))
+    #define RC_SIMD_X86
+    #include <immintrin.h>
+    #if defined( _MSC_VER )
+        #include <intrin.h>
+    #endif
+    // GCC and clang only allow the intrinsics in functions that are compiled for the instruction set, MSVC always does
+    #if defined( __GNUC__ ) || defined( __clang__ )
+        #define RC_TARGET_SSE2 __attribute__(( target( "sse2" )))
+        #define RC_TARGET_AVX2 __attribute__(( target( "avx2" )))
+    #else
+        #define RC_TARGET_SSE2
+        #define RC_TARGET_AVX2
+    #endif
+#endif
+
+namespace rcc {
+
+    enum SimdLevel { SIMD_SCALAR = 0, SIMD_SSE2, SIMD_AVX2 };
+
+    inline const char *SimdLevelName( SimdLevel level ) {
+        switch (level) {
+            case SIMD_SSE2: return "SSE2";
+            case SIMD_AVX2: return "AVX2";
+            default:        return "scalar";
+        }
+    }
+
+    // returns the best instruction set that the CPU (and the OS) supports
+    inline SimdLevel DetectSimdLevel() {
+#if defined( RC_SIMD_X86 )
+    #if defined( _MSC_VER )
+        int info[4];
+        __cpuid( info, 0 );
+        int nIds = info[0];
+        __cpuid( info, 1 );
+        bool bSSE2  = (info[3] & (1 << 26)) != 0;
+        // AVX2 also needs the OS to save the ymm registers (OSXSAVE + XCR0 bits 1 and 2)
+        bool bYmmOS = (info[2] & (1 << 27)) != 0 && (info[2] & (1 << 28)) != 0 && (_xgetbv( 0 ) & 6) == 6;
+        if (nIds >= 7 && bYmmOS) {
+            __cpuidex( info, 7, 0 );
+            if ((info[1] & (1 << 5)) != 0) { return SIMD_AVX2; }
+        }
+        if (bSSE2) { return SIMD_SSE2; }
+    #else
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports( "avx2" )) { return SIMD_AVX2; }
+        if (__builtin_cpu_supports( "sse2" )) { return SIMD_SSE2; }
+    #endif
+#endif
+        return SIMD_SCALAR;
+    }
+
+    // -----   SCALAR KERNELS   -----
+
+    inline void ShadeSpanScalar( uint32_t *pDst, const uint32_t *pSrc, int n, float f ) {
+        for (int i = 0; i < n; i++) {
+            uint32_t texel = pSrc[i];
+            int red   = GetR( texel ) * f;
+            int green = GetG( texel ) * f;
+            int blue  = GetB( texel ) * f;
+            pDst[i] = PackRGB( red, green, blue );
+        }
+    }
+
+    inline void BlitKeyedScalar( uint32_t *pDst, const uint32_t *pSrc, int n, uint32_t nKey ) {
+        for (int i = 0; i < n; i++) {
+            if (pSrc[i] != nKey) { pDst[i] = pSrc[i]; }
+        }
+    }
+
+    inline void DepthTestScalar( uint32_t *pRow, const float *pDepth, int n, float fDepth, uint32_t nKey ) {
+        for (int i = 0; i < n; i++) {
+            if (!(fDepth < pDepth[i])) { pRow[i] = nKey; }
+        }
+    }
+
+#if defined( RC_SIMD_X86 )
+
+    // -----   SSE2 KERNELS   -----
+
+    // 4 pixels at a time - each channel is masked out into its own vector of 4 ints, converted to float, multiplied,
+    // truncated back to int, and shifted back into place
+    RC_TARGET_SSE2 inline void ShadeSpanSSE2( uint32_t *pDst, const uint32_t *pSrc, int n, float f ) {
+        const __m128i mByte  = _mm_set1_epi32( 0xFF );
+        const __m128i mAlpha = _mm_set1_epi32( -0x01000000 );   // 0xFF000000
+        const __m128  mF     = _mm_set1_ps( f );
+        int i = 0;
+        for (; i + 4 <= n; i += 4) {
+            __m128i p = _mm_loadu_si128( (const __m128i *)(pSrc + i));
+            __m128i r = _mm_cvttps_epi32( _mm_mul_ps( _mm_cvtepi32_ps( _mm_and_si128(                   p,       mByte )), mF ));
+            __m128i g = _mm_cvttps_epi32( _mm_mul_ps( _mm_cvtepi32_ps( _mm_and_si128( _mm_srli_epi32( p,  8 ), mByte )), mF ));
+            __m128i b = _mm_cvttps_epi32( _mm_mul_ps( _mm_cvtepi32_ps( _mm_and_si128( _mm_srli_epi32( p, 16 ), mByte )), mF ));
+            r = _mm_and_si128( r, mByte );
+            g = _mm_slli_epi32( _mm_and_si128( g, mByte ),  8 );
+            b = _mm_slli_epi32( _mm_and_si128( b, mByte ), 16 );
+            _mm_storeu_si128( (__m128i *)(pDst + i), _mm_or_si128( _mm_or_si128( r, g ), _mm_or_si128( b, mAlpha )));
+        }
+        ShadeSpanScalar( pDst + i, pSrc + i, n - i, f );
+    }
+
+    // 4 pixels at a time - the destination pixels are blended with the key mask (and written back unchanged where the
+    // source has the key colour)
+    RC_TARGET_SSE2 inline void BlitKeyedSSE2( uint32_t *pDst, const uint32_t *pSrc, int n, uint32_t nKey ) {
+        const __m128i mKey = _mm_set1_epi32( int( nKey ));
+        int i = 0;
+        for (; i + 4 <= n; i += 4) {
+            __m128i s = _mm_loadu_si128( (const __m128i *)(pSrc + i));
+            __m128i d = _mm_loadu_si128( (const __m128i *)(pDst + i));
+            __m128i m = _mm_cmpeq_epi32( s, mKey );
+            _mm_storeu_si128( (__m128i *)(pDst + i), _mm_or_si128( _mm_and_si128( m, d ), _mm_andnot_si128( m, s )));
+        }
+        BlitKeyedScalar( pDst + i, pSrc + i, n - i, nKey );
+    }
+
+    // 4 pixels at a time - the compare gives a mask of the pixels in front, the others are blended to the key colour
+    RC_TARGET_SSE2 inline void DepthTestSSE2( uint32_t *pRow, const float *pDepth, int n, float fDepth, uint32_t nKey ) {
+        const __m128i mKey   = _mm_set1_epi32( int( nKey ));
+        const __m128  mDepth = _mm_set1_ps( fDepth );
+        int i = 0;
+        for (; i + 4 <= n; i += 4) {
+            __m128i p = _mm_loadu_si128( (const __m128i *)(pRow + i));
+            __m128i m = _mm_castps_si128( _mm_cmplt_ps( mDepth, _mm_loadu_ps( pDepth + i )));
+            _mm_storeu_si128( (__m128i *)(pRow + i), _mm_or_si128( _mm_and_si128( m, p ), _mm_andnot_si128( m, mKey )));
+        }
+        DepthTestScalar( pRow + i, pDepth + i, n - i, fDepth, nKey );
+    }
+
+    // -----   AVX2 KERNELS   -----
+
+    // same as the SSE2 version, 8 pixels at a time
+    RC_TARGET_AVX2 inline void ShadeSpanAVX2( uint32_t *pDst, const uint32_t *pSrc, int n, float f ) {
+        const __m256i mByte  = _mm256_set1_epi32( 0xFF );
+        const __m256i mAlpha = _mm256_set1_epi32( -0x01000000 );   // 0xFF000000
+        const __m256  mF     = _mm256_set1_ps( f );
+        int i = 0;
+        for (; i + 8 <= n; i += 8) {
+            __m256i p = _mm256_loadu_si256( (const __m256i *)(pSrc + i));
+            __m256i r = _mm256_cvttps_epi32( _mm256_mul_ps( _mm256_cvtepi32_ps( _mm256_and_si256(                      p,       mByte )), mF ));
+            __m256i g = _mm256_cvttps_epi32( _mm256_mul_ps( _mm256_cvtepi32_ps( _mm256_and_si256( _mm256_srli_epi32( p,  8 ), mByte )), mF ));
+            __m256i b = _mm256_cvttps_epi32( _mm256_mul_ps( _mm256_cvtepi32_ps( _mm256_and_si256( _mm256_srli_epi32( p, 16 ), mByte )), mF ));
+            r = _mm256_and_si256( r, mByte );
+            g = _mm256_slli_epi32( _mm256_and_si256( g, mByte ),  8 );
+            b = _mm256_slli_epi32( _mm256_and_si256( b, mByte ), 16 );
+            _mm256_storeu_si256( (__m256i *)(pDst + i), _mm256_or_si256( _mm256_or_si256( r, g ), _mm256_or_si256( b, mAlpha )));
+        }
+        ShadeSpanScalar( pDst + i, pSrc + i, n - i, f );
+    }
+
+    // 8 pixels at a time - a masked store only writes the pixels that don't have the key colour
+    RC_TARGET_AVX2 inline void BlitKeyedAVX2( uint32_t *pDst, const uint32_t *pSrc, int n, uint32_t nKey ) {
+        const __m256i mKey  = _mm256_set1_epi32( int( nKey ));
+        const __m256i mOnes = _mm256_set1_epi32( -1 );
+        int i = 0;
+        for (; i + 8 <= n; i += 8) {
+            __m256i s = _mm256_loadu_si256( (const __m256i *)(pSrc + i));
+            __m256i m = _mm256_xor_si256( _mm256_cmpeq_epi32( s, mKey ), mOnes );
+            _mm256_maskstore_epi32( (int *)(pDst + i), m, s );
+        }
+        BlitKeyedScalar( pDst + i, pSrc + i, n - i, nKey );
+    }
+
+    // same as the SSE2 version, 8 pixels at a time
+    RC_TARGET_AVX2 inline void DepthTestAVX2( uint32_t *pRow, const float *pDepth, int n, float fDepth, uint32_t nKey ) {
+        const __m256i mKey   = _mm256_set1_epi32( int( nKey ));
+        const __m256  mDepth = _mm256_set1_ps( fDepth );
+        int i = 0;
+        for (; i + 8 <= n; i += 8) {
+            __m256i p = _mm256_loadu_si256( (const __m256i *)(pRow + i));
+            __m256i m = _mm256_castps_si256( _mm256_cmp_ps( mDepth, _mm256_loadu_ps( pDepth + i ), _CMP_LT_OQ ));
+            _mm256_storeu_si256( (__m256i *)(pRow + i), _mm256_blendv_epi8( mKey, p, m ));
+        }
+        DepthTestScalar( pRow + i, pDepth + i, n - i, fDepth, nKey );
+    }
+
+#endif // RC_SIMD_X86
+
+    // -----   DISPATCH   -----
+
+    struct SimdKernels {
+        SimdLevel level;
+        void (*ShadeSpan)( uint32_t *pDst, const uint32_t *pSrc, int n, float f );
+        void (*BlitKeyed)( uint32_t *pDst, const uint32_t *pSrc, int n, uint32_t nKey );
+        void (*DepthTest)( uint32_t *pRow, const float *pDepth, int n, float fDepth, uint32_t nKey );
+    };
+
+    inline SimdKernels MakeSimdKernels( SimdLevel level ) {
+#if defined( RC_SIMD_X86 )
+        if (level == SIMD_AVX2) { return { SIMD_AVX2, ShadeSpanAVX2, BlitKeyedAVX2, DepthTestAVX2 }; }
+        if (level == SIMD_SSE2) { return { SIMD_SSE2, ShadeSpanSSE2, BlitKeyedSSE2, DepthTestSSE2 }; }
+#endif
+        return { SIMD_SCALAR, ShadeSpanScalar, BlitKeyedScalar, DepthTestScalar };
+    }
+
+    inline SimdKernels &SimdTable() {
+        static SimdKernels kernels = MakeSimdKernels( DetectSimdLevel());
+        return kernels;
+    }
+
+    // the kernels for the best supported instruction set (or the one set with SetSimdLevel())
+    inline const SimdKernels &Simd() { return SimdTable(); }
+
+    // restricts the kernels to (at most) the given instruction set, for testing and benchmarking - returns the level
+    // that is actually used. Don't call this while a frame is being rendered
+    inline SimdLevel SetSimdLevel( SimdLevel level ) {
+        SimdTable() = MakeSimdKernels( std::min( level, DetectSimdLevel()));
+        return SimdTable().level;
+    }
+
+    // -----   COMPOSITE KERNELS   -----
+
+    // Draws a textured, shaded wall strip of nW x nH pixels at pDst. Row y shows texel pTex[int( ty ) * nTexSize],
+    // with ty stepped by ty_step per row - nTexSize is the width of the texture (smaller for the mip levels). The
+    // texels are gathered in chunks and shaded with one ShadeSpan() call per chunk.
+    inline void ShadeStrip( uint32_t *pDst, int nStride, int nW, int nH, const uint32_t *pTex, float ty, float ty_step, float f, int nTexSize = TEX_SIZE ) {
+        const int nChunk = 64;
+        uint32_t buf[nChunk];
+        for (int y0 = 0; y0 < nH; y0 += nChunk) {
+            int n = std::min( nChunk, nH - y0 );
+            for (int i = 0; i < n; i++) {
+                buf[i] = pTex[int( ty ) * nTexSize];
+                ty += ty_step;
+            }
+            Simd().ShadeSpan( buf, buf, n, f );
+            for (int i = 0; i < n; i++, pDst += nStride) {
+                FrameBuffer::FillSpan( pDst, nW, buf[i] );
+            }
+        }
+    }
+
+    // same as above, with ty and ty_step in 16.16 fixed point (see rcFixed.h) - the texel row is just a shift (and a
+    // mask, in case the rounded step overshoots the last row)
+    inline void ShadeStrip( uint32_t *pDst, int nStride, int nW, int nH, const uint32_t *pTex, fix16 ty, fix16 ty_step, float f, int nTexSize = TEX_SIZE ) {
+        const int nChunk = 64;
+        uint32_t buf[nChunk];
+        for (int y0 = 0; y0 < nH; y0 += nChunk) {
+            int n = std::min( nChunk, nH - y0 );
+            for (int i = 0; i < n; i++) {
+                buf[i] = pTex[((ty >> FIX_SHIFT) & (nTexSize - 1)) * nTexSize];
+                ty += ty_step;
+            }
+            Simd().ShadeSpan( buf, buf, n, f );
+            for (int i = 0; i < n; i++, pDst += nStride) {
+                FrameBuffer::FillSpan( pDst, nW, buf[i] );
+            }
+        }
+    }
+
+} // namespace rcc
+
+#endif // RC_SIMD_H
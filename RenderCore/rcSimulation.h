@@ -0,0 +1,184 @@
+// Render core - simulation
+// ========================
+
+/* Short description
+   -----------------
+   Building blocks to run the game logic (enemies, pickups, doors) on its own thread, at a fixed rate, independent of
+   the frame rate:
+
+     * FixedStepThread runs a step function a fixed number of times per second, with a fixed time step. If a step
+       takes too long, the thread catches up with extra steps (up to SIM_MAX_CATCHUP), after that the backlog is
+       dropped so that a slow step can't make it fall behind forever.
+     * SnapshotBuffer<T> hands the state from the simulation to the renderer. The simulation fills the back buffer and
+       publishes it, the renderer takes the latest published snapshot. A snapshot never changes after it's published,
+       so the renderer can use it for a whole frame without locking - the lock is only held to swap or copy a pointer,
+       so neither side ever waits for the other to finish its work. The buffers are recycled: a snapshot goes back to
+       the pool when the last reader lets go of it, and becomes the next back buffer. So it's double buffered as long
+       as the renderer keeps up, and a third buffer is allocated when it doesn't.
+
+   The game state that the simulation owns belongs in the snapshot type, including anything the renderer has to
+   draw. Data that rarely changes (like the map) can be shared between snapshots through a std::shared_ptr<const ...>,
+   and replaced by a changed copy when it does change.
+ */
+
+#ifndef RC_SIMULATION_H
+#define RC_SIMULATION_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <algorithm>
+
+#include "rcDefines.h"
+
+namespace rcc {
+
+    // ====================   SnapshotBuffer   ==============================
+
+    template <class T>
+    class SnapshotBuffer {
+
+    public:
+        SnapshotBuffer() : pPool( std::make_shared<Pool>()) {
+            Back();
+            Publish();
+        }
+
+        // the writer side - the buffer to fill for the next snapshot. No reader has access to it. It's a buffer that
+        // was used before, so it holds an older snapshot
+        T &Back() {
+            if (pBack == nullptr) {
+                std::lock_guard<std::mutex> lock( pPool->mtx );
+                if (pPool->vFree.empty()) {
+                    pBack.reset( new T());
+                } else {
+                    pBack = std::move( pPool->vFree.back());
+                    pPool->vFree.pop_back();
+                }
+            }
+            return *pBack;
+        }
+        // publishes the back buffer as the latest snapshot
+        void Publish() {
+            Back();
+            // when the last holder of the snapshot lets go of it, the buffer goes back to the pool - under the lock, so
+            // that the reads of the holder are done before the writer can get the buffer again
+            std::shared_ptr<Pool> pool = pPool;
+            std::shared_ptr<const T> pNew( pBack.release(), [pool]( const T *p ) {
+                std::lock_guard<std::mutex> lock( pool->mtx );
+                pool->vFree.emplace_back( const_cast<T *>( p ));
+            } );
+            std::shared_ptr<const T> pOld;
+            {
+                std::lock_guard<std::mutex> lock( pPool->mtx );
+                pOld = std::move( pFront );
+                pFront = std::move( pNew );
+                nVersion++;
+            }
+            // pOld is released here, outside of the lock
+        }
+
+        // the reader side - the latest published snapshot. It stays valid and unchanged as long as the pointer is held
+        std::shared_ptr<const T> Latest() const {
+            std::lock_guard<std::mutex> lock( pPool->mtx );
+            return pFront;
+        }
+        // number of snapshots published so far
+        uint64_t Version() const {
+            std::lock_guard<std::mutex> lock( pPool->mtx );
+            return nVersion;
+        }
+
+    private:
+        // the buffers that nobody holds - shared with the snapshots, which return their buffer to it
+        struct Pool {
+            std::mutex mtx;
+            std::vector<std::unique_ptr<T>> vFree;
+        };
+        std::shared_ptr<Pool> pPool;
+        std::unique_ptr<T> pBack;          // the writer's buffer
+        std::shared_ptr<const T> pFront;   // the latest snapshot
+        uint64_t nVersion = 0;
+    };
+
+    // ====================   FixedStepThread   ==============================
+
+    class FixedStepThread {
+
+    public:
+        ~FixedStepThread() { Stop(); }
+
+        // starts calling step( fDt ) fStepsPerSecond times per second (fDt = 1 / fStepsPerSecond) on a new thread -
+        // stops the thread that is running first
+        void Start( float fStepsPerSecond, std::function<void( float )> step ) {
+            Stop();
+            fStep    = 1.0f / std::max( fStepsPerSecond, 1.0f );
+            stepFunc = std::move( step );
+            nSteps   = 0;
+            bRunning = true;
+            thread   = std::thread( &FixedStepThread::Run, this );
+        }
+        // stops the thread - after the step that is running (if any) has finished
+        void Stop() {
+            {
+                std::lock_guard<std::mutex> lock( mtx );
+                if (!bRunning) {
+                    return;
+                }
+                bRunning = false;
+            }
+            cvStop.notify_all();
+            if (thread.joinable()) {
+                thread.join();
+            }
+        }
+        bool IsRunning() const {
+            std::lock_guard<std::mutex> lock( mtx );
+            return bRunning;
+        }
+        // number of steps done since Start()
+        uint64_t Steps() const { return nSteps.load( std::memory_order_relaxed ); }
+
+    private:
+        typedef std::chrono::steady_clock Clock;
+
+        mutable std::mutex mtx;
+        std::condition_variable cvStop;
+        std::thread thread;
+        std::function<void( float )> stepFunc;
+        std::atomic<uint64_t> nSteps{ 0 };
+        float fStep = 1.0f / 60.0f;
+        bool bRunning = false;
+
+        void Run() {
+            const auto tStep = std::chrono::duration_cast<Clock::duration>( std::chrono::duration<double>( fStep ));
+            auto tNext = Clock::now();
+            std::unique_lock<std::mutex> lock( mtx );
+            while (bRunning) {
+                lock.unlock();
+                // do the steps that are due - if it's too far behind, skip the rest of the backlog
+                int nDone = 0;
+                while (Clock::now() >= tNext && nDone < SIM_MAX_CATCHUP) {
+                    stepFunc( fStep );
+                    nSteps.fetch_add( 1, std::memory_order_relaxed );
+                    tNext += tStep;
+                    nDone++;
+                }
+                if (Clock::now() >= tNext) {
+                    tNext = Clock::now() + tStep;
+                }
+                lock.lock();
+                cvStop.wait_until( lock, tNext, [this] { return !bRunning; } );
+            }
+        }
+    };
+
+} // namespace rcc
+
+#endif // RC_SIMULATION_H
@@ -0,0 +1,257 @@
+// Render core - texture pack
+// ==========================
+
+/* Short description
+   -----------------
+   A compact binary file format for textures and screens, so that they don't have to be compiled in as giant int array
+   literals anymore. The texture packer tool (Tools/TexturePacker.cpp) converts the .ppm files (and the screen code files)
+   offline into a texture pack, and the game loads it at startup. Swapping art is then a matter of rebuilding the pack,
+   not the engine.
+
+   File layout (all values little endian):
+
+       header   - char[4] magic "RCTP", uint32 version, uint32 number of entries
+       entries  - per entry: char[24] name (zero padded), uint32 width, uint32 height, uint32 offset
+       pixels   - packed 32 bit texels, in the same layout as the frame buffer (r in the lowest byte)
+
+   The offset of an entry is the byte offset of its first texel from the start of the file. Offsets are 4 byte aligned,
+   so that the texels can be used in place when the file is memory mapped (which assumes a little endian host, like all
+   platforms the PGE runs on).
+ */
+
+#ifndef RC_TEXTUREPACK_H
+#define RC_TEXTUREPACK_H
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#if defined( _WIN32 )
+    #ifndef NOMINMAX
+    #define NOMINMAX
+    #endif
+    #include <windows.h>
+#elif defined( __unix__ ) || defined( __APPLE__ )
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+    #define RC_HAS_MMAP
+#endif
+
+#define RCTP_MAGIC      "RCTP"
+#define RCTP_VERSION    1
+#define RCTP_NAME_LEN   24
+
+namespace rcc {
+
+    struct TexturePackEntry {
+        char     sName[RCTP_NAME_LEN];
+        uint32_t nWidth;
+        uint32_t nHeight;
+        uint32_t nOffset;   // byte offset of the texels from the start of the file
+    };
+
+    // -----   WRITING   -----
+
+    // the texture packer collects its input in these
+    struct TexturePackImage {
+        std::string           sName;
+        int                   nWidth  = 0;
+        int                   nHeight = 0;
+        std::vector<uint32_t> vTexels;   // packed texels, nWidth x nHeight
+    };
+
+    // writes the images into a texture pack file - returns false if the file could not be written
+    inline bool SaveTexturePack( const std::string &sFileName, const std::vector<TexturePackImage> &vImages ) {
+
+        auto put_u32 = []( std::vector<uint8_t> &buf, uint32_t v ) {
+            for (int i = 0; i < 4; i++) { buf.push_back( uint8_t( v >> (8 * i) )); }
+        };
+
+        uint32_t nOffset = 12 + uint32_t( vImages.size()) * (RCTP_NAME_LEN + 12);
+
+        std::vector<uint8_t> vHeader;
+        vHeader.insert( vHeader.end(), RCTP_MAGIC, RCTP_MAGIC + 4 );
+        put_u32( vHeader, RCTP_VERSION );
+        put_u32( vHeader, uint32_t( vImages.size()));
+        for (auto &img : vImages) {
+            char sName[RCTP_NAME_LEN] = { 0 };
+            strncpy( sName, img.sName.c_str(), RCTP_NAME_LEN - 1 );
+            vHeader.insert( vHeader.end(), sName, sName + RCTP_NAME_LEN );
+            put_u32( vHeader, uint32_t( img.nWidth  ));
+            put_u32( vHeader, uint32_t( img.nHeight ));
+            put_u32( vHeader, nOffset );
+            nOffset += uint32_t( img.vTexels.size()) * 4;
+        }
+
+        FILE *pFile = fopen( sFileName.c_str(), "wb" );
+        if (pFile == nullptr) {
+            return false;
+        }
+        bool bOK = fwrite( vHeader.data(), 1, vHeader.size(), pFile ) == vHeader.size();
+        for (auto &img : vImages) {
+            std::vector<uint8_t> vPixels;
+            vPixels.reserve( img.vTexels.size() * 4 );
+            for (uint32_t t : img.vTexels) { put_u32( vPixels, t ); }
+            bOK = bOK && fwrite( vPixels.data(), 1, vPixels.size(), pFile ) == vPixels.size();
+        }
+        fclose( pFile );
+        return bOK;
+    }
+
+    // -----   READING   -----
+
+    // A loaded texture pack. Where the platform supports it the file is memory mapped, so the texels are only paged in
+    // when they are used. Otherwise the file is read into memory in one go.
+    class TexturePack {
+
+    public:
+        TexturePack() {}
+        ~TexturePack() { Close(); }
+
+        TexturePack( const TexturePack & ) = delete;
+        TexturePack &operator = ( const TexturePack & ) = delete;
+
+        bool Load( const std::string &sFileName ) {
+            Close();
+
+            if (!MapFile( sFileName )) {
+                return false;
+            }
+            // validate the header and all the entries
+            if (nSize < 12 || memcmp( pData, RCTP_MAGIC, 4 ) != 0 || ReadU32( 4 ) != RCTP_VERSION) {
+                std::cout << "ERROR: TexturePack::Load() --> not a (supported) texture pack: " << sFileName << std::endl;
+                Close();
+                return false;
+            }
+            uint32_t nEntries = ReadU32( 8 );
+            if (12 + size_t( nEntries ) * (RCTP_NAME_LEN + 12) > nSize) {
+                std::cout << "ERROR: TexturePack::Load() --> header is truncated: " << sFileName << std::endl;
+                Close();
+                return false;
+            }
+            for (uint32_t i = 0; i < nEntries; i++) {
+                size_t nPos = 12 + size_t( i ) * (RCTP_NAME_LEN + 12);
+                TexturePackEntry e;
+                memcpy( e.sName, pData + nPos, RCTP_NAME_LEN );
+                e.sName[RCTP_NAME_LEN - 1] = '\0';
+                e.nWidth  = ReadU32( nPos + RCTP_NAME_LEN + 0 );
+                e.nHeight = ReadU32( nPos + RCTP_NAME_LEN + 4 );
+                e.nOffset = ReadU32( nPos + RCTP_NAME_LEN + 8 );
+                if (e.nOffset % 4 != 0 || size_t( e.nOffset ) + size_t( e.nWidth ) * e.nHeight * 4 > nSize) {
+                    std::cout << "ERROR: TexturePack::Load() --> entry " << e.sName << " is out of range: " << sFileName << std::endl;
+                    Close();
+                    return false;
+                }
+                vEntries.push_back( e );
+            }
+            return true;
+        }
+
+        void Close() {
+#if defined( RC_HAS_MMAP )
+            if (bMapped && pData != nullptr) { munmap( (void *)pData, nSize ); }
+#elif defined( _WIN32 )
+            if (bMapped && pData != nullptr) { UnmapViewOfFile( pData ); }
+#endif
+            bMapped = false;
+            pData   = nullptr;
+            nSize   = 0;
+            vBuffer.clear();
+            vEntries.clear();
+        }
+
+        bool IsMapped() const { return bMapped; }
+
+        const std::vector<TexturePackEntry> &Entries() const { return vEntries; }
+
+        // returns the entry with name sName, or nullptr if there's no such entry
+        const TexturePackEntry *Find( const std::string &sName ) const {
+            for (auto &e : vEntries) {
+                if (sName == e.sName) { return &e; }
+            }
+            return nullptr;
+        }
+
+        // pointer to the packed texels of entry e
+        const uint32_t *Texels( const TexturePackEntry &e ) const {
+            return reinterpret_cast<const uint32_t *>( pData + e.nOffset );
+        }
+
+    private:
+        const uint8_t *pData   = nullptr;
+        size_t         nSize   = 0;
+        bool           bMapped = false;
+        std::vector<uint8_t> vBuffer;   // only used if the file is not memory mapped
+        std::vector<TexturePackEntry> vEntries;
+
+        uint32_t ReadU32( size_t nPos ) const {
+            return uint32_t( pData[nPos] ) | (uint32_t( pData[nPos + 1] ) << 8) | (uint32_t( pData[nPos + 2] ) << 16) | (uint32_t( pData[nPos + 3] ) << 24);
+        }
+
+        bool MapFile( const std::string &sFileName ) {
+#if defined( RC_HAS_MMAP )
+            int fd = open( sFileName.c_str(), O_RDONLY );
+            if (fd >= 0) {
+                struct stat st;
+                if (fstat( fd, &st ) == 0 && st.st_size > 0) {
+                    void *p = mmap( nullptr, size_t( st.st_size ), PROT_READ, MAP_PRIVATE, fd, 0 );
+                    if (p != MAP_FAILED) {
+                        pData   = static_cast<const uint8_t *>( p );
+                        nSize   = size_t( st.st_size );
+                        bMapped = true;
+                    }
+                }
+                close( fd );
+                if (bMapped) { return true; }
+            }
+#elif defined( _WIN32 )
+            HANDLE hFile = CreateFileA( sFileName.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr );
+            if (hFile != INVALID_HANDLE_VALUE) {
+                LARGE_INTEGER liSize;
+                if (GetFileSizeEx( hFile, &liSize ) && liSize.QuadPart > 0) {
+                    HANDLE hMapping = CreateFileMappingA( hFile, nullptr, PAGE_READONLY, 0, 0, nullptr );
+                    if (hMapping != nullptr) {
+                        void *p = MapViewOfFile( hMapping, FILE_MAP_READ, 0, 0, 0 );
+                        if (p != nullptr) {
+                            pData   = static_cast<const uint8_t *>( p );
+                            nSize   = size_t( liSize.QuadPart );
+                            bMapped = true;
+                        }
+                        CloseHandle( hMapping );   // the view keeps the mapping alive
+                    }
+                }
+                CloseHandle( hFile );
+                if (bMapped) { return true; }
+            }
+#endif
+            // no memory mapping available (or it failed) - read the file in one go
+            FILE *pFile = fopen( sFileName.c_str(), "rb" );
+            if (pFile == nullptr) {
+                std::cout << "ERROR: TexturePack::Load() --> can't open file: " << sFileName << std::endl;
+                return false;
+            }
+            fseek( pFile, 0, SEEK_END );
+            long nLen = ftell( pFile );
+            fseek( pFile, 0, SEEK_SET );
+            vBuffer.resize( nLen > 0 ? size_t( nLen ) : 0 );
+            bool bOK = nLen > 0 && fread( vBuffer.data(), 1, vBuffer.size(), pFile ) == vBuffer.size();
+            fclose( pFile );
+            if (!bOK) {
+                std::cout << "ERROR: TexturePack::Load() --> can't read file: " << sFileName << std::endl;
+                vBuffer.clear();
+                return false;
+            }
+            pData = vBuffer.data();
+            nSize = vBuffer.size();
+            return true;
+        }
+    };
+
+} // namespace rcc
+
+#endif // RC_TEXTUREPACK_H
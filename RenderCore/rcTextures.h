@@ -0,0 +1,199 @@
+// Render core - textures
+// ======================
+
+/* Short description
+   -----------------
+   The .ppm texture files are compiled in as int arrays with one int per colour channel, so a texel fetch costs three
+   scattered loads and the arrays are four times bigger than needed. The TextureAtlas converts such an array once into
+   packed 32 bit RGBA texels (same layout as the frame buffer), so that sampling a texture is a single load.
+
+   The atlas stores a column of square tiles (all textures and sprites are TEX_SIZE x TEX_SIZE), each tile laid out
+   contiguously. An atlas can also hold a single image that is not tiled, like the sky. Every load gives the atlas a
+   new generation (unique over all atlases), so that data made from its texels - like the sky panorama of the
+   renderer - knows when to rebuild, even if the texels were reloaded into the same buffer.
+
+   For the walls in the distance the texture set keeps a mip chain of the textures: each level is the level before it
+   at half the size, down to 1 x 1 texel tiles. Each texel is the average of a 2 x 2 block of the level before, so a
+   far wall samples a small level that is averaged, instead of skipping texels of the full size texture (which makes
+   distant walls shimmer when the camera moves).
+ */
+
+#ifndef RC_TEXTURES_H
+#define RC_TEXTURES_H
+
+#include <cstdint>
+#include <atomic>
+#include <vector>
+#include <string>
+#include <iostream>
+#include <algorithm>
+
+#include "rcDefines.h"
+#include "rcFrameBuffer.h"
+#include "rcTexturePack.h"
+
+namespace rcc {
+
+    class TextureAtlas {
+
+    public:
+        TextureAtlas() {}
+
+        // converts an int-per-channel array of nW x nH pixels (like the ones in the .ppm files) into packed texels
+        void LoadFromInts( const int *pData, int nW, int nH ) {
+            nWidth  = nW;
+            nHeight = nH;
+            nGeneration = NextGeneration();
+            vTexels.resize( size_t( nW ) * nH );
+            for (size_t i = 0; i < vTexels.size(); i++) {
+                vTexels[i] = PackRGB( pData[i * 3 + 0], pData[i * 3 + 1], pData[i * 3 + 2] );
+            }
+        }
+
+        // copies nW x nH texels that are already packed (for instance from a texture pack)
+        void LoadFromTexels( const uint32_t *pData, int nW, int nH ) {
+            nWidth  = nW;
+            nHeight = nH;
+            nGeneration = NextGeneration();
+            vTexels.assign( pData, pData + size_t( nW ) * nH );
+        }
+
+        // makes this atlas a half size copy of src - each texel is the average of a 2 x 2 block of src. A column of
+        // tiles stays a column of tiles, at half the tile size
+        void LoadHalfSize( const TextureAtlas &src ) {
+            nWidth  = std::max( 1, src.nWidth  / 2 );
+            nHeight = std::max( 1, src.nHeight / 2 );
+            nGeneration = NextGeneration();
+            vTexels.resize( size_t( nWidth ) * nHeight );
+            for (int y = 0; y < nHeight; y++) {
+                for (int x = 0; x < nWidth; x++) {
+                    int x0 = std::min( x * 2, src.nWidth  - 1 ), x1 = std::min( x * 2 + 1, src.nWidth  - 1 );
+                    int y0 = std::min( y * 2, src.nHeight - 1 ), y1 = std::min( y * 2 + 1, src.nHeight - 1 );
+                    uint32_t p[4] = { src.FetchImage( x0, y0 ), src.FetchImage( x1, y0 ), src.FetchImage( x0, y1 ), src.FetchImage( x1, y1 ) };
+                    int r = 2, g = 2, b = 2, a = 2;   // rounded average
+                    for (uint32_t c : p) {
+                        r += GetR( c );
+                        g += GetG( c );
+                        b += GetB( c );
+                        a += int( c >> 24 );
+                    }
+                    vTexels[size_t( y ) * nWidth + x] = PackRGB( r / 4, g / 4, b / 4, a / 4 );
+                }
+            }
+        }
+
+        // loads entry sName from texture pack - returns false if there's no such entry, if the entry is empty, or if its
+        // size doesn't match nExpW x nExpH (a size of 0 matches any width or height)
+        bool LoadFromPack( const TexturePack &pack, const std::string &sName, int nExpW = 0, int nExpH = 0 ) {
+            const TexturePackEntry *pEntry = pack.Find( sName );
+            if (pEntry == nullptr) {
+                std::cout << "ERROR: TextureAtlas::LoadFromPack() --> texture pack has no entry: " << sName << std::endl;
+                return false;
+            }
+            const int nW = int( pEntry->nWidth ), nH = int( pEntry->nHeight );
+            if (nW <= 0 || nH <= 0 || (nExpW > 0 && nW != nExpW) || (nExpH > 0 && nH != nExpH)) {
+                std::cout << "ERROR: TextureAtlas::LoadFromPack() --> entry " << sName << " is " << nW << "x" << nH
+                          << ", expected " << (nExpW > 0 ? std::to_string( nExpW ) : "any") << "x"
+                          << (nExpH > 0 ? std::to_string( nExpH ) : "any") << std::endl;
+                return false;
+            }
+            LoadFromTexels( pack.Texels( *pEntry ), int( pEntry->nWidth ), int( pEntry->nHeight ));
+            return true;
+        }
+
+        int Width()  const { return nWidth;  }
+        int Height() const { return nHeight; }
+        // number of TEX_SIZE x TEX_SIZE tiles in the atlas (for atlases that are TEX_SIZE wide)
+        int Tiles()  const { return nHeight / TEX_SIZE; }
+
+        // pointer to the first texel of tile n
+        const uint32_t *Tile( int n ) const { return vTexels.data() + n * TEX_SIZE * TEX_SIZE; }
+        // pointer to the first texel of row y (for non tiled images)
+        const uint32_t *Row( int y ) const { return vTexels.data() + y * nWidth; }
+
+        // fetches texel (x, y) from tile n
+        uint32_t Fetch( int n, int x, int y ) const { return vTexels[(n * TEX_SIZE + y) * TEX_SIZE + x]; }
+        // fetches texel (x, y) from a non tiled image
+        uint32_t FetchImage( int x, int y ) const { return vTexels[y * nWidth + x]; }
+
+        const uint32_t *GetData() const { return vTexels.data(); }
+
+        // changes with every Load...() call - 0 for an atlas that was never loaded
+        int Generation() const { return nGeneration; }
+
+    private:
+        int nWidth  = 0;
+        int nHeight = 0;
+        int nGeneration = 0;
+        std::vector<uint32_t> vTexels;
+
+        // an atlas generation that no atlas has had before
+        static int NextGeneration() {
+            static std::atomic<int> nLastGeneration( 0 );
+            return nLastGeneration.fetch_add( 1, std::memory_order_relaxed ) + 1;
+        }
+    };
+
+    // all textures the renderer needs
+    struct TextureSet {
+        TextureAtlas textures;   // All_Textures[] - NR_TEXTURES tiles for walls, floors and ceilings
+        TextureAtlas sky;        // sky[]          - one image of SKY_X x SKY_Y
+        TextureAtlas sprites;    // sprites[]      - key, lamp, enemy
+        std::vector<TextureAtlas> mips;   // mip levels 1, 2, ... of textures (TEX_SIZE / 2, TEX_SIZE / 4, ... texels per tile)
+
+        // converts the arrays as they are included from the .ppm files
+        void LoadFromArrays( const int *All_Textures, const int *pSky, const int *pSprites, int nSprites = 3 ) {
+            textures.LoadFromInts( All_Textures, TEX_SIZE, TEX_SIZE * NR_TEXTURES );
+            sky.LoadFromInts(      pSky       , SKY_X   , SKY_Y                  );
+            sprites.LoadFromInts(  pSprites   , TEX_SIZE, TEX_SIZE * nSprites    );
+            BuildMips();
+        }
+
+        // loads the entries "textures", "sky" and "sprites" from a texture pack - returns false if an entry is missing,
+        // or if its size doesn't match what the renderer indexes: NR_TEXTURES tiles of TEX_SIZE x TEX_SIZE, a sky of
+        // SKY_X wide and at least SKY_Y high, and a column of at least one sprite tile
+        bool LoadFromPack( const TexturePack &pack ) {
+            if (!textures.LoadFromPack( pack, "textures", TEX_SIZE, TEX_SIZE * NR_TEXTURES ) ||
+                !sky.LoadFromPack(      pack, "sky"     , SKY_X                            ) ||
+                !sprites.LoadFromPack(  pack, "sprites" , TEX_SIZE                         )) {
+                return false;
+            }
+            if (sky.Height() < SKY_Y) {
+                std::cout << "ERROR: TextureSet::LoadFromPack() --> sky is " << sky.Width() << "x" << sky.Height()
+                          << ", must be at least " << SKY_X << "x" << SKY_Y << std::endl;
+                return false;
+            }
+            if (sprites.Height() % TEX_SIZE != 0) {
+                std::cout << "ERROR: TextureSet::LoadFromPack() --> sprites are " << sprites.Width() << "x" << sprites.Height()
+                          << ", height must be a multiple of " << TEX_SIZE << std::endl;
+                return false;
+            }
+            BuildMips();
+            return true;
+        }
+
+        // builds the mip chain of textures, down to tiles of 1 x 1 texel. The Load...() functions do this - if textures
+        // is loaded or changed otherwise, call it again
+        void BuildMips() {
+            mips.clear();
+            if (textures.Width() != TEX_SIZE) {
+                return;
+            }
+            int nLevels = 0;
+            for (int nSize = TEX_SIZE / 2; nSize >= 1; nSize /= 2) {
+                nLevels++;
+            }
+            mips.resize( nLevels );
+            for (int i = 0; i < nLevels; i++) {
+                mips[i].LoadHalfSize( i == 0 ? textures : mips[i - 1] );
+            }
+        }
+        // the number of mip levels that can be used - 0 if the chain doesn't match textures (anymore)
+        int MipLevels() const {
+            return !mips.empty() && mips[0].Height() == textures.Height() / 2 ? int( mips.size()) : 0;
+        }
+    };
+
+} // namespace rcc
+
+#endif // RC_TEXTURES_H
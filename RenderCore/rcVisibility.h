@@ -0,0 +1,119 @@
+// Render core - visibility
+// ========================
+
+/* Short description
+   -----------------
+   Potentially visible sets (PVS) of the tiles of a map: for a tile, the set of tiles that can be seen from somewhere
+   in that tile. Only the walls block the view, so a PVS depends on the wall layer alone, and can be computed once
+   and reused until the walls change (a door is opened, for instance).
+
+   The renderer finds the tiles that are visible in a frame itself (see Renderer::GetVisibleTiles()). The PVS is for
+   game logic that has to know what could be seen from a position without rendering from there - for instance to
+   only update the enemies that could see the player, or to skip objects that can't be seen from the camera tile.
+
+   A PVS is computed by casting PVS_RAYS rays in all directions from the center and from four points near the corners
+   of the tile, and collecting all tiles the rays pass through. That's a sample, so a tile that is only visible
+   through a very narrow gap can be missed.
+
+   Since the set is a sample, it isn't exactly symmetric either: tile B can be in the PVS of tile A while A isn't in the
+   PVS of B (again only through very narrow gaps).
+
+   PvsCache keeps the sets of the last PVS_CACHE_SIZE tiles it was asked for (a PVS has a bit per map tile, so for big
+   maps they aren't kept for all tiles). It's meant for a few tiles that are asked for over and over - like the tile
+   of the player - not for one lookup per object: with more objects in different tiles than the cache holds, every
+   lookup builds a set. Hits() and Misses() tell how well the cache works out. The cache is emptied when the version of the map changes, which includes
+   being asked about another map (see Map::nVersion).
+ */
+
+#ifndef RC_VISIBILITY_H
+#define RC_VISIBILITY_H
+
+#include <cmath>
+#include <cstdint>
+#include <vector>
+#include <algorithm>
+
+#include "rcDefines.h"
+#include "rcMap.h"
+#include "rcRayCast.h"
+
+namespace rcc {
+
+    // computes the potentially visible set of tile (tx, ty) into pvs (see the description above)
+    inline void BuildPvs( const Map &map, int tx, int ty, TileSet &pvs ) {
+        if (!pvs.Matches( map.mapX, map.mapY )) {
+            pvs.Resize( map.mapX, map.mapY );
+        } else {
+            pvs.Clear();
+        }
+        if (!map.InBounds( tx, ty )) {
+            return;
+        }
+        const float fS = float( map.mapS );
+        const float fOffsets[5][2] = { { 0.5f, 0.5f }, { 0.125f, 0.125f }, { 0.875f, 0.125f }, { 0.125f, 0.875f }, { 0.875f, 0.875f } };
+        for (const auto &offset : fOffsets) {
+            float x = (tx + offset[0]) * fS, y = (ty + offset[1]) * fS;
+            for (int n = 0; n < PVS_RAYS; n++) {
+                float fAngle = 2.0f * PI * float( n ) / float( PVS_RAYS );
+                CastRay( map, x, y, std::cos( fAngle ), std::sin( fAngle ), 1000000.0f, false, &pvs );
+            }
+        }
+    }
+
+    class PvsCache {
+
+    public:
+        PvsCache( int nMaxEntries = PVS_CACHE_SIZE ) : nMax( std::max( 1, nMaxEntries )) {}
+
+        // the potentially visible set of tile (tx, ty) of the map - computed if it isn't in the cache. The reference
+        // is valid until the next call
+        const TileSet &Get( const Map &map, int tx, int ty ) {
+            if (map.nVersion != nMapVersion || map.mapX != nMapX || map.mapY != nMapY) {
+                Invalidate();
+                nMapVersion = map.nVersion;
+                nMapX = map.mapX;
+                nMapY = map.mapY;
+            }
+            const int nTile = map.InBounds( tx, ty ) ? map.Index( tx, ty ) : -1;
+            for (Entry &e : vEntries) {
+                if (e.nTile == nTile) {
+                    nHits++;
+                    return e.pvs;
+                }
+            }
+            nMisses++;
+            // not in the cache - replace the oldest entry when the cache is full
+            if (int( vEntries.size()) < nMax) {
+                vEntries.emplace_back();
+            } else {
+                std::rotate( vEntries.begin(), vEntries.begin() + 1, vEntries.end());
+            }
+            Entry &e = vEntries.back();
+            e.nTile = nTile;
+            BuildPvs( map, tx, ty, e.pvs );
+            return e.pvs;
+        }
+
+        // true if tile (x, y) is potentially visible from tile (tx, ty)
+        bool CanSee( const Map &map, int tx, int ty, int x, int y ) { return Get( map, tx, ty ).Test( x, y ); }
+
+        void Invalidate() { vEntries.clear(); }
+
+        // the number of lookups that were served from the cache, and the number that had to build a set
+        uint64_t Hits()   const { return nHits;   }
+        uint64_t Misses() const { return nMisses; }
+
+    private:
+        struct Entry {
+            int nTile = -1;
+            TileSet pvs;
+        };
+        int nMax;
+        int nMapVersion = -1, nMapX = 0, nMapY = 0;
+        std::vector<Entry> vEntries;   // oldest first
+        uint64_t nHits = 0, nMisses = 0;
+    };
+
+} // namespace rcc
+
+#endif // RC_VISIBILITY_H
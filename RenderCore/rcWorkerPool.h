@@ -0,0 +1,154 @@
+// Render core - worker pool
+// =========================
+
+/* Short description
+   -----------------
+   A persistent pool of worker threads for the render core. The threads are created once and sleep between jobs, so
+   there's no thread creation cost per frame.
+
+   ParallelFor() splits an index range over the participants (the workers plus the calling thread) in contiguous
+   bands. Each participant works through its own band in chunks of nGrain indices, and when it runs out of work it
+   steals chunks from the bands of the other participants. That way expensive parts of the range (for instance
+   screen columns with a lot of floor) are balanced out over all threads.
+
+   The job function must be safe to call concurrently for different chunks. Which thread processes which chunk is not
+   deterministic, so the job should only write to data that belongs to its own chunk.
+ */
+
+#ifndef RC_WORKERPOOL_H
+#define RC_WORKERPOOL_H
+
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <vector>
+#include <algorithm>
+
+namespace rcc {
+
+    class WorkerPool {
+
+    public:
+        // nThreads is the total number of threads working on a job, including the calling thread - if it is 0 the
+        // number of hardware threads is used
+        WorkerPool( int nThreads = 0 ) {
+            if (nThreads <= 0) {
+                nThreads = std::max( 1, int( std::thread::hardware_concurrency()));
+            }
+            nParticipants = nThreads;
+            pBands.reset( new Band[nParticipants] );
+            for (int i = 1; i < nParticipants; i++) {
+                vThreads.emplace_back( &WorkerPool::WorkerMain, this, i );
+            }
+        }
+
+        ~WorkerPool() {
+            {
+                std::lock_guard<std::mutex> lock( mtx );
+                bQuit = true;
+            }
+            cvStart.notify_all();
+            for (auto &t : vThreads) { t.join(); }
+        }
+
+        WorkerPool( const WorkerPool & ) = delete;
+        WorkerPool &operator = ( const WorkerPool & ) = delete;
+
+        int Threads() const { return nParticipants; }
+
+        // calls job( nChunkBegin, nChunkEnd ) for consecutive chunks of (at most) nGrain indices that together cover
+        // [nBegin, nEnd), and returns when all chunks are done
+        void ParallelFor( int nBegin, int nEnd, int nGrain, const std::function<void( int, int )> &job ) {
+            if (nEnd <= nBegin) {
+                return;
+            }
+            nGrain = std::max( 1, nGrain );
+            if (nParticipants == 1 || nEnd - nBegin <= nGrain) {
+                job( nBegin, nEnd );
+                return;
+            }
+            {
+                std::lock_guard<std::mutex> lock( mtx );
+                // divide the range in one contiguous band per participant
+                int nCount = nEnd - nBegin;
+                for (int i = 0; i < nParticipants; i++) {
+                    pBands[i].nNext.store( nBegin + int( (long long)nCount *  i      / nParticipants ), std::memory_order_relaxed );
+                    pBands[i].nEnd =       nBegin + int( (long long)nCount * (i + 1) / nParticipants );
+                }
+                pJob       = &job;
+                nJobGrain  = nGrain;
+                nBusy      = nParticipants - 1;
+                nGeneration += 1;
+            }
+            cvStart.notify_all();
+
+            // the calling thread is participant 0
+            RunJob( 0 );
+
+            std::unique_lock<std::mutex> lock( mtx );
+            cvDone.wait( lock, [this] { return nBusy == 0; } );
+            pJob = nullptr;
+        }
+
+    private:
+        // the part of the index range that is assigned to one participant - the next index to process is claimed
+        // with an atomic add, both by the owner and by thieves
+        struct alignas( 64 ) Band {
+            std::atomic<int> nNext{ 0 };
+            int nEnd = 0;
+        };
+
+        int nParticipants = 1;
+        std::unique_ptr<Band[]> pBands;
+        std::vector<std::thread> vThreads;
+
+        std::mutex mtx;
+        std::condition_variable cvStart, cvDone;
+        unsigned long long nGeneration = 0;    // incremented for each job, wakes up the workers
+        int  nBusy = 0;                        // number of workers that haven't finished the current job
+        bool bQuit = false;
+
+        const std::function<void( int, int )> *pJob = nullptr;
+        int nJobGrain = 1;
+
+        // process own band first, then steal from the other bands
+        void RunJob( int nSelf ) {
+            for (int k = 0; k < nParticipants; k++) {
+                Band &band = pBands[(nSelf + k) % nParticipants];
+                for (;;) {
+                    int i = band.nNext.fetch_add( nJobGrain, std::memory_order_relaxed );
+                    if (i >= band.nEnd) {
+                        break;
+                    }
+                    (*pJob)( i, std::min( i + nJobGrain, band.nEnd ));
+                }
+            }
+        }
+
+        void WorkerMain( int nSelf ) {
+            unsigned long long nSeen = 0;
+            std::unique_lock<std::mutex> lock( mtx );
+            for (;;) {
+                cvStart.wait( lock, [&] { return bQuit || nGeneration != nSeen; } );
+                if (bQuit) {
+                    return;
+                }
+                nSeen = nGeneration;
+                lock.unlock();
+
+                RunJob( nSelf );
+
+                lock.lock();
+                if (--nBusy == 0) {
+                    cvDone.notify_one();
+                }
+            }
+        }
+    };
+
+} // namespace rcc
+
+#endif // RC_WORKERPOOL_H
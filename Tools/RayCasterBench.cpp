@@ -0,0 +1,664 @@
+// Ray caster benchmark
+// ====================
+
+// Offline frame time benchmark for the render core - replays scripted camera paths without opening a window
+
+// Dependencies:
+//   *  RenderCore/RenderCore.h - headless render core
+//   *  Textures/textures.rctp  - texture pack (optional - procedural textures are used if it can't be loaded)
+
+
+/* Short description
+   -----------------
+   The game itself is driven by live keyboard input, and the only metric it has is the FPS in the title bar of the PGE
+   window. This tool renders a camera path through a map with the render core, and measures the time spent
+   in each render stage (sky, ray setup, ray casting / DDA, walls, floor and ceiling, sprites). Per stage the
+   mean, the 50th / 90th / 99th percentile and the worst frame time are reported, and optionally written to a JSON
+   file, so that results can be compared between versions.
+
+   The map is the episode 3 map (the default), a map file (see RenderCore/rcMap.h for the format), or a generated open
+   level of any size, with wall blocks scattered around and a cross shaped corridor through the middle - to measure
+   long range rays. With the default one wall block in 12 tiles no tile is SKIP_MIN_DIST away from a wall, so the ray
+   caster never skips empty space there. The number of skips over all measured frames is reported (and written to the
+   JSON file) - to measure the empty space skipping, generate a sparser map with --wall-blocks and compare --skip on
+   with --skip off, for instance:
+
+       RayCasterBench --map gen:512x512 --wall-blocks 2000 --skip on
+       RayCasterBench --map gen:512x512 --wall-blocks 2000 --skip off
+
+   The camera path is a list of keyframes (position and angle) that is interpolated linearly over the frames. There are
+   built in paths that walk through all rooms of the episode 3 map, and along the corridors of a generated map. A
+   custom path can be read from a text file with one keyframe per line:
+
+       <px> <py> <pa>
+
+   Lines starting with # are ignored. Positions are in world coordinates (TILE_SIZE units per tile), angles in degrees.
+
+   Usage:
+       RayCasterBench [options]
+
+       --help                 print the usage and exit
+       --frames <n>           number of measured frames (default 600)
+       --warmup <n>           number of frames rendered before measuring (default 30)
+       --size <w>x<h>         frame buffer size (default SCREEN_X x SCREEN_Y)
+       --slice <n>            slice width in pixels (default SLICE_WIDTH)
+       --threads <n>          render threads, 0 = all hardware threads (default 1)
+       --floor rows|columns   floor casting mode (default rows)
+       --simd scalar|sse2|avx2  restrict the SIMD kernels (default: best supported)
+       --skip on|off          empty space skipping in the ray caster (default on)
+       --pixel-depth on|off   fill the per pixel depth surface (default off)
+       --sprites <n>          scatter n extra sprites over the map (default 0)
+       --visibility on|off    record the visible tiles, and cull the sprites with them (default off)
+       --mips on|off          sample mip levels of the textures for distant walls (default on)
+       --pack <file>          texture pack (default Textures/textures.rctp)
+       --map <map>            episode3 (default), gen:<w>x<h> for a generated map, or a map file
+       --wall-blocks <n>      one in n tiles of a generated map is a wall block, 0 = none (default 12)
+       --path <file>          camera path file (default: built in path - required for map files)
+       --json <file>          write the results as JSON
+       --save <file>          save the last frame as a .ppm file
+       --compare <file>       compare the last frame with a reference .ppm file (for instance one saved by a float build
+                              when testing an RC_FIXED_POINT build)
+       --tolerance <pct>      percentage of pixels that may differ from the reference (default 0) - if more pixels
+                              differ, the exit code is 2
+
+   The JSON output also contains a checksum over all rendered frames. It only changes if the rendered output changes,
+   so it doubles as a quick regression check for optimizations that should not change the image. For optimizations
+   that do change the image a little (like the fixed point pipeline), save the last frame of a reference run with
+   --save, and check against it with --compare and --tolerance.
+
+   Build with -DNDEBUG for release timings: without it the render loops check their texel reads (see
+   RenderCore/rcChecks.h). The run reports whether the checks are on, and the JSON config has them as checked_access.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <algorithm>
+
+#include "../RenderCore/RenderCore.h"
+
+// the render core pipeline is selected at compile time - build with -DRC_FIXED_POINT for the fixed point one
+#if defined( RC_FIXED_POINT )
+const bool bFixedPoint = true;
+#else
+const bool bFixedPoint = false;
+#endif
+
+// ====================   Scene   ==============================
+
+struct Keyframe {
+    float px, py, pa;
+};
+
+// the episode 3 map and objects, as set up in AnotherRayCaster::init()
+void InitEpisode3( rcc::Map &map, rcc::EntityStore &entities ) {
+    map.LoadFromStrings( 8, 8,
+        "CCCBCWCC" "E..B...C" "C..D.B.C" "BBDB...C" "C......C" "C....C.C" "B......C" "CCWCWCWC",
+        "11111111" "12213331" "12223331" "11213331" "13332221" "13332221" "13332221" "11111111",
+        "0000...." "0330...." "0333..4." "0030...." ".434...." "........" "........" "........" );
+
+    float fMapS = float( map.mapS );
+    entities.Clear();
+    entities.Add( { SPRITE_KEY  , 1, 0, 1.5f * fMapS, 5.0f * fMapS, 20 } );   // key
+    entities.Add( { SPRITE_LIGHT, 1, 1, 1.5f * fMapS, 4.5f * fMapS,  0 } );   // light 1
+    entities.Add( { SPRITE_LIGHT, 1, 1, 3.5f * fMapS, 4.5f * fMapS,  0 } );   // light 2
+    entities.Add( { SPRITE_ENEMY, 1, 2, 2.5f * fMapS, 2.0f * fMapS, 20 } );   // enemy
+}
+
+// a walk through all rooms of the episode 3 map, starting and ending at the start position of the player
+std::vector<Keyframe> Episode3Path() {
+    return {
+        { 150.0f, 400.0f,  90.0f },
+        { 160.0f, 290.0f,  90.0f },
+        { 300.0f, 290.0f,   0.0f },
+        { 420.0f, 290.0f,  45.0f },
+        { 420.0f, 150.0f,  90.0f },
+        { 290.0f, 100.0f, 180.0f },
+        { 290.0f, 170.0f, 270.0f },
+        { 420.0f, 400.0f, 315.0f },
+        { 100.0f, 400.0f, 180.0f },
+        {  96.0f, 290.0f,  90.0f },
+        { 150.0f, 400.0f,  90.0f },
+    };
+}
+
+// Generates an open level of nW x nH tiles: walls around the border, randomly placed wall blocks (about one in
+// nWallBlocks tiles, none if it's 0), and a cross shaped corridor through the middle that is kept free. The floor types vary per 4 x 4
+// tile block, and there's a ceiling over one in four of those blocks. The objects are placed along the corridor.
+void InitGenerated( rcc::Map &map, rcc::EntityStore &entities, int nW, int nH, int nWallBlocks ) {
+    const char sWalls[]  = { WALL_CBRD, WALL_BRCK, WINDOW, WALL_END };
+    const char sFloors[] = { FLOOR_WOOD, FLOOR_BRCK, FLOOR_1, FLOOR_2, FLOOR_3, FLOOR_4 };
+    const char sCeils[]  = { CEIL_BRCK, CEIL_1, CEIL_2, CEIL_3 };
+
+    // small LCG, so that the map is the same on every platform
+    uint32_t nSeed = 12345;
+    auto next_rand = [&]() { nSeed = nSeed * 1664525u + 1013904223u; return nSeed >> 8; };
+
+    map.Resize( nW, nH );
+    int cx = nW / 2, cy = nH / 2;
+    for (int y = 0; y < nH; y++) {
+        for (int x = 0; x < nW; x++) {
+            int i = map.Index( x, y );
+            bool bBorder   = x == 0 || y == 0 || x == nW - 1 || y == nH - 1;
+            bool bCorridor = x == cx || y == cy;
+            if (bBorder || (!bCorridor && nWallBlocks > 0 && next_rand() % nWallBlocks == 0)) {
+                map.mapW[i] = sWalls[next_rand() % 4];
+            }
+            uint32_t nBlock = uint32_t( (y / 4) * 7919 + (x / 4) * 104729 );
+            map.mapF[i] = sFloors[nBlock % 6];
+            map.mapC[i] = nBlock % 4 == 0 ? sCeils[(nBlock / 4) % 4] : EMPTY;
+        }
+    }
+    map.UpdateOccupancy();
+    map.UpdateTextures();
+
+    float fMapS = float( map.mapS );
+    float fCX = (cx + 0.5f) * fMapS, fCY = (cy + 0.5f) * fMapS;
+    entities.Clear();
+    entities.Add( { SPRITE_KEY  , 1, 0, fCX - 3.0f * fMapS, fCY, 20 } );   // key
+    entities.Add( { SPRITE_LIGHT, 1, 1, fCX + 2.0f * fMapS, fCY,  0 } );   // lights
+    entities.Add( { SPRITE_LIGHT, 1, 1, fCX, fCY - 2.0f * fMapS,  0 } );
+    entities.Add( { SPRITE_ENEMY, 1, 2, fCX, fCY + 4.0f * fMapS, 20 } );   // enemy
+}
+
+// Adds nCount lights and keys at random empty tiles of the map (at a random spot within the tile) - a crowded level,
+// to measure the sprite culling, sorting and drawing
+void AddScattered( const rcc::Map &map, rcc::EntityStore &entities, int nCount ) {
+    uint32_t nSeed = 54321;
+    auto next_rand = [&]() { nSeed = nSeed * 1664525u + 1013904223u; return nSeed >> 8; };
+
+    float fMapS = float( map.mapS );
+    entities.Reserve( entities.Size() + nCount );
+    for (int n = 0, nTries = 0; n < nCount && nTries < 100 * nCount; nTries++) {
+        int x = int( next_rand() % map.mapX ), y = int( next_rand() % map.mapY );
+        if (map.Wall( x, y ) != EMPTY) {
+            continue;
+        }
+        float fX = (x + 0.25f + 0.5f * float( next_rand() % 256 ) / 256.0f) * fMapS;
+        float fY = (y + 0.25f + 0.5f * float( next_rand() % 256 ) / 256.0f) * fMapS;
+        if (n % 4 == 0) {
+            entities.Add( { SPRITE_KEY  , 1, 0, fX, fY, 20 } );
+        } else {
+            entities.Add( { SPRITE_LIGHT, 1, 1, fX, fY,  0 } );
+        }
+        n++;
+    }
+}
+
+// along the corridors of a generated map of nW x nH tiles: looking down the long corridors, and turning around in
+// the middle
+std::vector<Keyframe> GeneratedPath( int nW, int nH ) {
+    float fMapS = float( TILE_SIZE );
+    float fCX = (nW / 2 + 0.5f) * fMapS, fCY = (nH / 2 + 0.5f) * fMapS;
+    float fMinX = 1.5f * fMapS, fMaxX = (nW - 1.5f) * fMapS;
+    float fMinY = 1.5f * fMapS, fMaxY = (nH - 1.5f) * fMapS;
+    return {
+        { fMinX, fCY,   0.0f },
+        { fCX  , fCY,  45.0f },
+        { fCX  , fMinY, 90.0f },
+        { fCX  , fCY, 270.0f },
+        { fCX  , fMaxY, 270.0f },
+        { fCX  , fCY, 180.0f },
+        { fMaxX, fCY,   0.0f },
+    };
+}
+
+// reads a camera path file - returns false if the file can't be read or has less than two keyframes
+bool LoadPath( const std::string &sFileName, std::vector<Keyframe> &vPath ) {
+    std::ifstream file( sFileName );
+    if (!file.is_open()) {
+        std::cout << "ERROR: LoadPath() --> can't read file - " << sFileName << std::endl;
+        return false;
+    }
+    vPath.clear();
+    std::string sLine;
+    while (std::getline( file, sLine )) {
+        if (sLine.empty() || sLine[0] == '#') {
+            continue;
+        }
+        std::istringstream ss( sLine );
+        Keyframe k;
+        if (ss >> k.px >> k.py >> k.pa) {
+            vPath.push_back( k );
+        }
+    }
+    if (vPath.size() < 2) {
+        std::cout << "ERROR: LoadPath() --> a path needs at least two keyframes - " << sFileName << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// camera at fraction t in [0, 1] of the path - the angle is interpolated over the shortest arc
+rcc::Camera CameraOnPath( const std::vector<Keyframe> &vPath, float t ) {
+    float fPos = t * (vPath.size() - 1);
+    int   nKey = std::min( int( fPos ), int( vPath.size()) - 2 );
+    float f    = fPos - nKey;
+    const Keyframe &a = vPath[nKey], &b = vPath[nKey + 1];
+
+    float fDeltaA = b.pa - a.pa;
+    if (fDeltaA >  180.0f) { fDeltaA -= 360.0f; }
+    if (fDeltaA < -180.0f) { fDeltaA += 360.0f; }
+
+    rcc::Camera cam;
+    cam.px = a.px + (b.px - a.px) * f;
+    cam.py = a.py + (b.py - a.py) * f;
+    cam.pa = rcc::Renderer::FixAng( a.pa + fDeltaA * f );
+    return cam;
+}
+
+// ====================   Procedural textures   ==============================
+
+// Stand in textures for when there's no texture pack: brick and checker patterns in a different colour per tile, a
+// sky gradient, and round sprites on a magenta (transparent) background. They have the same sizes as the real ones,
+// so the render cost is the same.
+void MakeProceduralTextures( rcc::TextureSet &tex ) {
+    const int nTexels = TEX_SIZE * TEX_SIZE;
+    const int palette[NR_TEXTURES][3] = {
+        { 160,  90,  60 }, { 120, 120, 130 }, {  90, 140, 200 }, { 170,  60,  50 }, { 130,  90,  40 },
+        {  80, 160,  80 }, { 150, 150, 100 }, { 100, 100, 160 }, { 190, 170, 120 }, {  90,  70,  90 },
+    };
+
+    std::vector<uint32_t> vTextures( nTexels * NR_TEXTURES );
+    for (int n = 0; n < NR_TEXTURES; n++) {
+        for (int y = 0; y < TEX_SIZE; y++) {
+            for (int x = 0; x < TEX_SIZE; x++) {
+                bool bDark = n % 2 == 0 ? (y % 8 == 0 || (x + (y / 8 % 2) * 8) % 16 == 0)   // bricks
+                                        : ((x / 8 + y / 8) % 2 == 0);                      // checker board
+                float f = bDark ? 0.5f : 1.0f - ((x ^ y) & 3) * 0.05f;
+                vTextures[n * nTexels + y * TEX_SIZE + x] = rcc::PackRGB( int( palette[n][0] * f ), int( palette[n][1] * f ), int( palette[n][2] * f ));
+            }
+        }
+    }
+    tex.textures.LoadFromTexels( vTextures.data(), TEX_SIZE, TEX_SIZE * NR_TEXTURES );
+
+    std::vector<uint32_t> vSky( SKY_X * SKY_Y );
+    for (int y = 0; y < SKY_Y; y++) {
+        for (int x = 0; x < SKY_X; x++) {
+            int nCloud = (x * 7 + y * 3) % 23 < 4 ? 60 : 0;
+            vSky[y * SKY_X + x] = rcc::PackRGB( 40 + y * 2 + nCloud, 80 + y * 2 + nCloud, 200 + nCloud / 2 );
+        }
+    }
+    tex.sky.LoadFromTexels( vSky.data(), SKY_X, SKY_Y );
+
+    const int nSprites = 3;
+    std::vector<uint32_t> vSprites( nTexels * nSprites );
+    for (int n = 0; n < nSprites; n++) {
+        for (int y = 0; y < TEX_SIZE; y++) {
+            for (int x = 0; x < TEX_SIZE; x++) {
+                int dx = x - TEX_SIZE / 2, dy = y - TEX_SIZE / 2;
+                bool bInside = dx * dx + dy * dy < (TEX_SIZE / 2 - 2) * (TEX_SIZE / 2 - 2);
+                vSprites[n * nTexels + y * TEX_SIZE + x] = bInside ? rcc::PackRGB( 255 - n * 80, 200, n * 100 ) : rcc::PackRGB( 255, 0, 255 );
+            }
+        }
+    }
+    tex.sprites.LoadFromTexels( vSprites.data(), TEX_SIZE, TEX_SIZE * nSprites );
+    tex.BuildMips();
+}
+
+// ====================   Statistics   ==============================
+
+struct StageResult {
+    std::string sName;
+    double dMean, dP50, dP90, dP99, dMax;
+};
+
+// value at percentile p (in [0, 100]) of the sorted samples - nearest rank
+double Percentile( const std::vector<double> &vSorted, double p ) {
+    if (vSorted.empty()) {
+        return 0.0;
+    }
+    int nRank = int( std::ceil( p / 100.0 * vSorted.size())) - 1;
+    return vSorted[std::max( 0, std::min( nRank, int( vSorted.size()) - 1 ))];
+}
+
+StageResult Summarize( const std::string &sName, std::vector<double> vSamples ) {
+    StageResult res;
+    res.sName = sName;
+    std::sort( vSamples.begin(), vSamples.end());
+    double dSum = 0.0;
+    for (double d : vSamples) { dSum += d; }
+    res.dMean = vSamples.empty() ? 0.0 : dSum / vSamples.size();
+    res.dP50  = Percentile( vSamples, 50.0 );
+    res.dP90  = Percentile( vSamples, 90.0 );
+    res.dP99  = Percentile( vSamples, 99.0 );
+    res.dMax  = vSamples.empty() ? 0.0 : vSamples.back();
+    return res;
+}
+
+// FNV-1a over the pixels of a frame, folded into nHash
+uint64_t HashFrame( const rcc::FrameBuffer &frame, uint64_t nHash ) {
+    const uint32_t *pData = frame.GetData();
+    size_t nPixels = size_t( frame.Width()) * frame.Height();
+    for (size_t i = 0; i < nPixels; i++) {
+        nHash ^= pData[i];
+        nHash *= 1099511628211ull;
+    }
+    return nHash;
+}
+
+// sText as the contents of a JSON string - quotes, backslashes and control characters escaped
+std::string JsonEscape( const std::string &sText ) {
+    std::string sOut;
+    for (char c : sText) {
+        switch (c) {
+            case '"' : sOut += "\\\""; break;
+            case '\\': sOut += "\\\\"; break;
+            case '\n': sOut += "\\n";  break;
+            case '\r': sOut += "\\r";  break;
+            case '\t': sOut += "\\t";  break;
+            default:
+                if ((unsigned char)c < 0x20) {
+                    char sCode[8];
+                    snprintf( sCode, sizeof( sCode ), "\\u%04x", (unsigned char)c );
+                    sOut += sCode;
+                } else {
+                    sOut += c;
+                }
+        }
+    }
+    return sOut;
+}
+
+// ====================   Main   ==============================
+
+struct Options {
+    int nFrames  = 600;
+    int nWarmup  = 30;
+    int nWidth   = SCREEN_X;
+    int nHeight  = SCREEN_Y;
+    int nSlice   = SLICE_WIDTH;
+    int nThreads = 1;
+    bool bRowFloor = true;
+    bool bSkipEmpty = true;
+    bool bPixelDepth = false;
+    int nSprites = 0;
+    bool bVisibility = false;
+    bool bMips = true;
+    rcc::SimdLevel eSimd = rcc::SIMD_AVX2;
+    std::string sPack = "Textures/textures.rctp";
+    std::string sMap  = "episode3";
+    int nWallBlocks = 12;
+    std::string sPath, sJson, sSave, sCompare;
+    float fTolerance = 0.0f;
+    bool bHelp = false;
+};
+
+bool ParseOptions( int argc, char *argv[], Options &opt ) {
+    for (int i = 1; i < argc; i++) {
+        std::string sArg = argv[i];
+        if (sArg == "--help" || sArg == "-h") {
+            opt.bHelp = true;
+            return true;
+        }
+        if (i + 1 >= argc) {
+            std::cout << "ERROR: missing value for option " << sArg << std::endl;
+            return false;
+        }
+        std::string sVal = argv[++i];
+        if (sArg == "--frames") {
+            opt.nFrames = std::max( 1, atoi( sVal.c_str()));
+        } else if (sArg == "--warmup") {
+            opt.nWarmup = std::max( 0, atoi( sVal.c_str()));
+        } else if (sArg == "--size") {
+            if (sscanf( sVal.c_str(), "%dx%d", &opt.nWidth, &opt.nHeight ) != 2 || opt.nWidth <= 0 || opt.nHeight <= 0) {
+                std::cout << "ERROR: size must be of the form <w>x<h> - " << sVal << std::endl;
+                return false;
+            }
+        } else if (sArg == "--slice") {
+            opt.nSlice = std::max( 1, atoi( sVal.c_str()));
+        } else if (sArg == "--threads") {
+            opt.nThreads = std::max( 0, atoi( sVal.c_str()));
+        } else if (sArg == "--floor") {
+            if (sVal != "rows" && sVal != "columns") {
+                std::cout << "ERROR: floor mode must be rows or columns - " << sVal << std::endl;
+                return false;
+            }
+            opt.bRowFloor = sVal == "rows";
+        } else if (sArg == "--simd") {
+                 if (sVal == "scalar") { opt.eSimd = rcc::SIMD_SCALAR; }
+            else if (sVal == "sse2"  ) { opt.eSimd = rcc::SIMD_SSE2;   }
+            else if (sVal == "avx2"  ) { opt.eSimd = rcc::SIMD_AVX2;   }
+            else {
+                std::cout << "ERROR: simd level must be scalar, sse2 or avx2 - " << sVal << std::endl;
+                return false;
+            }
+        } else if (sArg == "--skip") {
+            if (sVal != "on" && sVal != "off") {
+                std::cout << "ERROR: empty space skipping must be on or off - " << sVal << std::endl;
+                return false;
+            }
+            opt.bSkipEmpty = sVal == "on";
+        } else if (sArg == "--pixel-depth") {
+            if (sVal != "on" && sVal != "off") {
+                std::cout << "ERROR: pixel depth must be on or off - " << sVal << std::endl;
+                return false;
+            }
+            opt.bPixelDepth = sVal == "on";
+        } else if (sArg == "--mips") {
+            if (sVal != "on" && sVal != "off") {
+                std::cout << "ERROR: mips must be on or off - " << sVal << std::endl;
+                return false;
+            }
+            opt.bMips = sVal == "on";
+        } else if (sArg == "--visibility") {
+            if (sVal != "on" && sVal != "off") {
+                std::cout << "ERROR: visibility must be on or off - " << sVal << std::endl;
+                return false;
+            }
+            opt.bVisibility = sVal == "on";
+        } else if (sArg == "--sprites") {
+            opt.nSprites = std::max( 0, atoi( sVal.c_str()));
+        } else if (sArg == "--pack") {
+            opt.sPack = sVal;
+        } else if (sArg == "--map") {
+            opt.sMap = sVal;
+        } else if (sArg == "--wall-blocks") {
+            opt.nWallBlocks = std::max( 0, atoi( sVal.c_str()));
+        } else if (sArg == "--path") {
+            opt.sPath = sVal;
+        } else if (sArg == "--json") {
+            opt.sJson = sVal;
+        } else if (sArg == "--save") {
+            opt.sSave = sVal;
+        } else if (sArg == "--compare") {
+            opt.sCompare = sVal;
+        } else if (sArg == "--tolerance") {
+            opt.fTolerance = std::max( 0.0f, float( atof( sVal.c_str())));
+        } else {
+            std::cout << "ERROR: unknown option " << sArg << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+bool WriteJson( const std::string &sFileName, const Options &opt, const rcc::Map &map, const std::string &sTextures, int nThreads,
+                rcc::SimdLevel eSimd, uint64_t nChecksum, uint64_t nSkips, const std::vector<StageResult> &vResults ) {
+    FILE *pFile = fopen( sFileName.c_str(), "w" );
+    if (pFile == nullptr) {
+        return false;
+    }
+    fprintf( pFile, "{\n" );
+    fprintf( pFile, "  \"config\": {\n" );
+    fprintf( pFile, "    \"width\": %d,\n", opt.nWidth );
+    fprintf( pFile, "    \"height\": %d,\n", opt.nHeight );
+    fprintf( pFile, "    \"slice_width\": %d,\n", opt.nSlice );
+    fprintf( pFile, "    \"threads\": %d,\n", nThreads );
+    fprintf( pFile, "    \"floor\": \"%s\",\n", opt.bRowFloor ? "rows" : "columns" );
+    fprintf( pFile, "    \"simd\": \"%s\",\n", rcc::SimdLevelName( eSimd ));
+    fprintf( pFile, "    \"skip_empty\": %s,\n", opt.bSkipEmpty ? "true" : "false" );
+    fprintf( pFile, "    \"pixel_depth\": %s,\n", opt.bPixelDepth ? "true" : "false" );
+    fprintf( pFile, "    \"sprites\": %d,\n", opt.nSprites );
+    fprintf( pFile, "    \"visibility\": %s,\n", opt.bVisibility ? "true" : "false" );
+    fprintf( pFile, "    \"mips\": %s,\n", opt.bMips ? "true" : "false" );
+    fprintf( pFile, "    \"fixed_point\": %s,\n", bFixedPoint ? "true" : "false" );
+    fprintf( pFile, "    \"checked_access\": %s,\n", rcc::Renderer::IsAccessChecked() ? "true" : "false" );
+    fprintf( pFile, "    \"textures\": \"%s\",\n", JsonEscape( sTextures ).c_str());
+    fprintf( pFile, "    \"map\": \"%s\",\n", JsonEscape( opt.sMap ).c_str());
+    fprintf( pFile, "    \"map_size\": [%d, %d],\n", map.mapX, map.mapY );
+    fprintf( pFile, "    \"wall_blocks\": %d,\n", opt.nWallBlocks );
+    fprintf( pFile, "    \"path\": \"%s\",\n", opt.sPath.empty() ? "built in" : JsonEscape( opt.sPath ).c_str());
+    fprintf( pFile, "    \"frames\": %d,\n", opt.nFrames );
+    fprintf( pFile, "    \"warmup\": %d\n", opt.nWarmup );
+    fprintf( pFile, "  },\n" );
+    fprintf( pFile, "  \"checksum\": \"%016llx\",\n", (unsigned long long)nChecksum );
+    fprintf( pFile, "  \"skips\": %llu,\n", (unsigned long long)nSkips );
+    fprintf( pFile, "  \"stages_ms\": {\n" );
+    for (size_t i = 0; i < vResults.size(); i++) {
+        const StageResult &r = vResults[i];
+        fprintf( pFile, "    \"%s\": { \"mean\": %.4f, \"p50\": %.4f, \"p90\": %.4f, \"p99\": %.4f, \"max\": %.4f }%s\n",
+                 JsonEscape( r.sName ).c_str(), r.dMean, r.dP50, r.dP90, r.dP99, r.dMax, i + 1 < vResults.size() ? "," : "" );
+    }
+    fprintf( pFile, "  }\n" );
+    fprintf( pFile, "}\n" );
+    fclose( pFile );
+    return true;
+}
+
+void PrintUsage() {
+    std::cout << "usage: RayCasterBench [--help] [--frames n] [--warmup n] [--size WxH] [--slice n] [--threads n] [--floor rows|columns]" << std::endl
+              << "                      [--simd scalar|sse2|avx2] [--skip on|off] [--pixel-depth on|off] [--sprites n] [--visibility on|off]" << std::endl
+              << "                      [--mips on|off] [--pack file] [--map episode3|gen:WxH|file] [--wall-blocks n] [--path file] [--json file] [--save file] [--compare file] [--tolerance pct]" << std::endl;
+}
+
+int main( int argc, char *argv[] )
+{
+    Options opt;
+    if (!ParseOptions( argc, argv, opt )) {
+        PrintUsage();
+        return 1;
+    }
+    if (opt.bHelp) {
+        PrintUsage();
+        return 0;
+    }
+
+    // scene
+    rcc::Map map;
+    rcc::EntityStore entities;
+    std::vector<Keyframe> vPath;
+    int nGenW = 0, nGenH = 0;
+    if (opt.sMap == "episode3") {
+        InitEpisode3( map, entities );
+        vPath = Episode3Path();
+    } else if (sscanf( opt.sMap.c_str(), "gen:%dx%d", &nGenW, &nGenH ) == 2) {
+        if (nGenW < 8 || nGenH < 8) {
+            std::cout << "ERROR: generated maps must be at least 8 x 8 tiles - " << opt.sMap << std::endl;
+            return 1;
+        }
+        InitGenerated( map, entities, nGenW, nGenH, opt.nWallBlocks );
+        vPath = GeneratedPath( nGenW, nGenH );
+    } else {
+        if (!map.LoadFromFile( opt.sMap )) {
+            return 1;
+        }
+        if (opt.sPath.empty()) {
+            std::cout << "ERROR: a camera path (--path) is needed for map files" << std::endl;
+            return 1;
+        }
+    }
+    if (!opt.sPath.empty() && !LoadPath( opt.sPath, vPath )) {
+        return 1;
+    }
+    AddScattered( map, entities, opt.nSprites );
+    entities.SetGrid( map.mapX, map.mapY, map.mapS );
+
+    // textures - from the texture pack if possible
+    rcc::TextureSet textures;
+    std::string sTextures = opt.sPack;
+    rcc::TexturePack pack;
+    if (!pack.Load( opt.sPack ) || !textures.LoadFromPack( pack )) {
+        std::cout << "using procedural textures" << std::endl;
+        MakeProceduralTextures( textures );
+        sTextures = "procedural";
+    }
+
+    // renderer
+    rcc::Renderer renderer( opt.nWidth, opt.nHeight, opt.nSlice );
+    renderer.SetThreads( opt.nThreads );
+    renderer.SetRowFloor( opt.bRowFloor );
+    renderer.SetEmptySpaceSkipping( opt.bSkipEmpty );
+    renderer.SetPixelDepth( opt.bPixelDepth );
+    renderer.SetWallMipmaps( opt.bMips );
+    renderer.SetTileVisibility( opt.bVisibility );
+    rcc::SimdLevel eSimd = rcc::SetSimdLevel( opt.eSimd );
+
+    std::cout << "map " << opt.sMap << " (" << map.mapX << " x " << map.mapY << " tiles), " << entities.Size() << " sprites" << std::endl;
+    std::cout << "rendering " << opt.nFrames << " frames of " << opt.nWidth << " x " << opt.nHeight << ", slice width " << opt.nSlice
+              << ", " << renderer.GetThreads() << " thread(s), " << (opt.bRowFloor ? "row" : "column") << " floor, "
+              << rcc::SimdLevelName( eSimd ) << " kernels, empty space skipping " << (opt.bSkipEmpty ? "on" : "off")
+              << (opt.bPixelDepth ? ", pixel depth" : "") << (opt.bVisibility ? ", tile visibility" : "") << (opt.bMips ? "" : ", no mips")
+              << (bFixedPoint ? ", fixed point" : "") << (rcc::Renderer::IsAccessChecked() ? ", checked access" : "") << std::endl;
+
+    const char *sStages[] = { "sky", "ray_setup", "dda", "walls", "floor_ceiling", "depth", "sprites", "total" };
+    const int nStages = 8;
+    std::vector<std::vector<double>> vSamples( nStages );
+    uint64_t nChecksum = 1469598103934665603ull;
+
+    uint64_t nSkips = 0;   // empty squares skipped by the ray caster, over all measured frames
+
+    uint32_t nClearCol = rcc::PackRGB( 64, 64, 64 );
+    for (int i = 0; i < opt.nWarmup; i++) {
+        renderer.renderFrame( CameraOnPath( vPath, float( i ) / opt.nWarmup ), map, textures, entities, nClearCol );
+    }
+    for (int i = 0; i < opt.nFrames; i++) {
+        float t = opt.nFrames > 1 ? float( i ) / (opt.nFrames - 1) : 0.0f;
+        renderer.renderFrame( CameraOnPath( vPath, t ), map, textures, entities, nClearCol );
+
+        const rcc::RenderStats &s = renderer.GetStats();
+        double dStage[nStages] = { s.dSky, s.dRaySetup, s.dCast, s.dWalls, s.dFloor, s.dDepth, s.dSprites, s.dTotal };
+        for (int k = 0; k < nStages; k++) {
+            vSamples[k].push_back( dStage[k] );
+        }
+        nSkips += uint64_t( s.nSkips );
+        nChecksum = HashFrame( renderer.GetFrame(), nChecksum );
+    }
+
+    std::vector<StageResult> vResults;
+    for (int k = 0; k < nStages; k++) {
+        vResults.push_back( Summarize( sStages[k], vSamples[k] ));
+    }
+
+    printf( "%-14s %9s %9s %9s %9s %9s\n", "stage (ms)", "mean", "p50", "p90", "p99", "max" );
+    for (auto &r : vResults) {
+        printf( "%-14s %9.3f %9.3f %9.3f %9.3f %9.3f\n", r.sName.c_str(), r.dMean, r.dP50, r.dP90, r.dP99, r.dMax );
+    }
+    const StageResult &total = vResults.back();
+    printf( "average fps: %.1f, checksum: %016llx\n", total.dMean > 0.0 ? 1000.0 / total.dMean : 0.0, (unsigned long long)nChecksum );
+    printf( "empty space skips: %llu (%.1f per frame)\n", (unsigned long long)nSkips, double( nSkips ) / opt.nFrames );
+    if (opt.bSkipEmpty && opt.bVisibility) {
+        printf( "no empty space is skipped while the visible tiles are recorded (--visibility on)\n" );
+    } else if (opt.bSkipEmpty && nSkips == 0) {
+        printf( "no empty space was skipped - the rays never passed a tile SKIP_MIN_DIST (%d) tiles from a wall, see --wall-blocks\n", SKIP_MIN_DIST );
+    }
+
+    if (!opt.sJson.empty() && !WriteJson( opt.sJson, opt, map, sTextures, renderer.GetThreads(), eSimd, nChecksum, nSkips, vResults )) {
+        std::cout << "ERROR: can't write results - " << opt.sJson << std::endl;
+        return 1;
+    }
+    if (!opt.sSave.empty() && !renderer.GetFrame().SavePPM( opt.sSave )) {
+        std::cout << "ERROR: can't save frame - " << opt.sSave << std::endl;
+        return 1;
+    }
+    if (!opt.sCompare.empty()) {
+        rcc::FrameBuffer reference( 1, 1 );
+        if (!reference.LoadPPM( opt.sCompare )) {
+            std::cout << "ERROR: can't read reference frame - " << opt.sCompare << std::endl;
+            return 1;
+        }
+        const rcc::FrameBuffer &frame = renderer.GetFrame();
+        double dPct = 100.0 * double( frame.CountDiffs( reference )) / (double( frame.Width()) * frame.Height());
+        printf( "pixels that differ from %s: %.3f%% (tolerance %.3f%%)\n", opt.sCompare.c_str(), dPct, opt.fTolerance );
+        if (dPct > opt.fTolerance) {
+            return 2;
+        }
+    }
+    return 0;
+}
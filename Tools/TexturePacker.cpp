@@ -0,0 +1,207 @@
+// Texture packer
+// ==============
+
+// Offline converter that builds a texture pack for the render core
+
+// Dependencies:
+//   *  RenderCore/rcTexturePack.h - texture pack file format
+
+
+/* Short description
+   -----------------
+   The episode 3 textures and screens used to be compiled in as int arrays (the .ppm files and the screen code files).
+   This tool converts them (once, offline) into a texture pack file that the game loads at startup - see
+   RenderCore/rcTexturePack.h for the file format.
+
+   Usage:
+       TexturePacker <output file> <name>=<input file>[:<width>x<height>] ...
+
+   The input files can be either
+     * C source with an int array, like the .ppm files in this repo ( int All_Textures[] = { 101, 64, 0, ... }; ),
+       with three ints per pixel. The size of the image must be given, since the source doesn't contain it;
+     * a real portable pixmap image (P3 or P6 format), as saved by most image editors. The size is read from the file.
+
+   For episode 3 the pack needs the entries textures, sky, sprites, title, won and lost. Run from the root of the
+   repo, where the .ppm files are (the Textures folder must exist, episode 3 loads the pack from there):
+
+       TexturePacker Textures/textures.rctp textures=Dungeon.ppm:32x320 sky=sky.ppm:120x80 sprites=Sprites.ppm:32x96
+                     title=<title screen>:960x640 won=<won screen>:960x640 lost=<lost screen>:960x640
+
+   The sources of the title, won and lost screens (the int arrays that screens.h declares) are not in this repo -
+   use your own copies of them, or any 960 x 640 portable pixmap (then leave out the size).
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cctype>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+
+#include "../RenderCore/rcFrameBuffer.h"
+#include "../RenderCore/rcTexturePack.h"
+
+// reads the whole file into a string - returns false if that's not possible
+bool ReadFile( const std::string &sFileName, std::string &sContents ) {
+    std::ifstream file( sFileName, std::ios::binary );
+    if (!file.is_open()) {
+        return false;
+    }
+    std::stringstream ss;
+    ss << file.rdbuf();
+    sContents = ss.str();
+    return true;
+}
+
+// parses a portable pixmap (P3 or P6) into img
+bool ParsePPM( const std::string &sData, rcc::TexturePackImage &img ) {
+    size_t nPos = 2;
+    // reads the next number from the header, skipping white space and comments
+    auto next_number = [&]() {
+        while (nPos < sData.size()) {
+            if (sData[nPos] == '#') {
+                while (nPos < sData.size() && sData[nPos] != '\n') { nPos++; }
+            } else if (isspace( (unsigned char)sData[nPos] )) {
+                nPos++;
+            } else {
+                break;
+            }
+        }
+        int nValue = 0;
+        while (nPos < sData.size() && isdigit( (unsigned char)sData[nPos] )) {
+            nValue = nValue * 10 + (sData[nPos++] - '0');
+        }
+        return nValue;
+    };
+
+    bool bBinary = sData[1] == '6';
+    img.nWidth  = next_number();
+    img.nHeight = next_number();
+    int nMax    = next_number();
+    if (img.nWidth <= 0 || img.nHeight <= 0 || nMax <= 0 || nMax > 255) {
+        std::cout << "ERROR: ParsePPM() --> unsupported header" << std::endl;
+        return false;
+    }
+    size_t nPixels = size_t( img.nWidth ) * img.nHeight;
+    img.vTexels.resize( nPixels );
+    if (bBinary) {
+        nPos++;   // exactly one white space character separates the header from the data
+        if (nPos + nPixels * 3 > sData.size()) {
+            std::cout << "ERROR: ParsePPM() --> file is truncated" << std::endl;
+            return false;
+        }
+        for (size_t i = 0; i < nPixels; i++) {
+            const unsigned char *p = (const unsigned char *)sData.data() + nPos + i * 3;
+            img.vTexels[i] = rcc::PackRGB( p[0], p[1], p[2] );
+        }
+    } else {
+        for (size_t i = 0; i < nPixels; i++) {
+            int r = next_number(), g = next_number(), b = next_number();
+            img.vTexels[i] = rcc::PackRGB( r, g, b );
+        }
+    }
+    return true;
+}
+
+// parses C source containing an int array initializer with three ints per pixel into img
+bool ParseIntArray( const std::string &sData, rcc::TexturePackImage &img ) {
+    size_t nStart = sData.find( '{' );
+    size_t nEnd   = sData.find( '}', nStart );
+    if (nStart == std::string::npos || nEnd == std::string::npos) {
+        std::cout << "ERROR: ParseIntArray() --> no array initializer found" << std::endl;
+        return false;
+    }
+    std::vector<int> vValues;
+    const char *p    = sData.c_str() + nStart + 1;
+    const char *pEnd = sData.c_str() + nEnd;
+    while (p < pEnd) {
+        if (isdigit( (unsigned char)*p ) || *p == '-') {
+            char *pNext;
+            vValues.push_back( int( strtol( p, &pNext, 10 )));
+            p = pNext;
+        } else {
+            p++;
+        }
+    }
+    size_t nPixels = size_t( img.nWidth ) * img.nHeight;
+    if (vValues.size() != nPixels * 3) {
+        std::cout << "ERROR: ParseIntArray() --> found " << vValues.size() << " values, expected " << nPixels * 3
+                  << " for " << img.nWidth << "x" << img.nHeight << " pixels" << std::endl;
+        return false;
+    }
+    img.vTexels.resize( nPixels );
+    for (size_t i = 0; i < nPixels; i++) {
+        img.vTexels[i] = rcc::PackRGB( vValues[i * 3 + 0], vValues[i * 3 + 1], vValues[i * 3 + 2] );
+    }
+    return true;
+}
+
+// parses one <name>=<input file>[:<width>x<height>] argument and loads the image
+bool LoadArgument( const std::string &sArg, rcc::TexturePackImage &img ) {
+    size_t nEq = sArg.find( '=' );
+    if (nEq == std::string::npos || nEq == 0) {
+        std::cout << "ERROR: argument must be of the form <name>=<file>[:<w>x<h>] - " << sArg << std::endl;
+        return false;
+    }
+    img.sName = sArg.substr( 0, nEq );
+    if (img.sName.size() >= RCTP_NAME_LEN) {
+        std::cout << "ERROR: name is too long (max " << RCTP_NAME_LEN - 1 << " characters) - " << img.sName << std::endl;
+        return false;
+    }
+    std::string sFile = sArg.substr( nEq + 1 );
+    // the size is optional, and only recognized if the part after the last colon is <digits>x<digits>
+    size_t nColon = sFile.rfind( ':' );
+    if (nColon != std::string::npos) {
+        std::string sSize = sFile.substr( nColon + 1 );
+        size_t nX = sSize.find( 'x' );
+        bool bIsSize = nX != std::string::npos && nX > 0 && nX + 1 < sSize.size();
+        for (size_t i = 0; bIsSize && i < sSize.size(); i++) {
+            bIsSize = i == nX || isdigit( (unsigned char)sSize[i] );
+        }
+        if (bIsSize) {
+            img.nWidth  = atoi( sSize.substr( 0, nX ).c_str());
+            img.nHeight = atoi( sSize.substr( nX + 1 ).c_str());
+            sFile       = sFile.substr( 0, nColon );
+        }
+    }
+
+    std::string sData;
+    if (!ReadFile( sFile, sData )) {
+        std::cout << "ERROR: can't read file - " << sFile << std::endl;
+        return false;
+    }
+    if (sData.size() > 2 && sData[0] == 'P' && (sData[1] == '3' || sData[1] == '6')) {
+        return ParsePPM( sData, img );
+    }
+    if (img.nWidth <= 0 || img.nHeight <= 0) {
+        std::cout << "ERROR: the size must be given for int array files - " << sArg << std::endl;
+        return false;
+    }
+    return ParseIntArray( sData, img );
+}
+
+int main( int argc, char *argv[] )
+{
+    if (argc < 3) {
+        std::cout << "usage: TexturePacker <output file> <name>=<input file>[:<width>x<height>] ..." << std::endl;
+        return 1;
+    }
+
+    std::vector<rcc::TexturePackImage> vImages;
+    for (int i = 2; i < argc; i++) {
+        rcc::TexturePackImage img;
+        if (!LoadArgument( argv[i], img )) {
+            return 1;
+        }
+        std::cout << img.sName << ": " << img.nWidth << " x " << img.nHeight << std::endl;
+        vImages.push_back( img );
+    }
+
+    if (!rcc::SaveTexturePack( argv[1], vImages )) {
+        std::cout << "ERROR: can't write texture pack - " << argv[1] << std::endl;
+        return 1;
+    }
+    return 0;
+}